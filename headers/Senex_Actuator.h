@@ -0,0 +1,192 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, or BOTH.        |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+//Haptics/LED command queue, run in the frame scheduler's slack (STAGE_ACTUATORS) so sensor reads never wait on it
+
+#ifndef _SENEX_ACTUATOR_H
+#define _SENEX_ACTUATOR_H
+
+#include <stdint.h>
+
+#include "Senex_Settings.h"
+
+struct FrameScheduler;
+
+//Actuator targets. Each target's data stays where it always lived (led_bank/led_ctrl, bank[130], I2CBank LED/wave,
+//eCtrl) - the queue only tracks what is pending, so a newer write to the same target simply replaces the older one.
+enum ActuatorTarget
+{
+	ACT_LOCAL_LED,		//This board's LEDs (led_bank + led_ctrl on the core)
+	ACT_LOCAL_VIBE,		//This board's DRV2605 (secondary I2C bus on the core)
+	ACT_LEFT_LED,		//Left hand LEDRed/Green/Blue  -> LINK_CTRL_LED (core only)
+	ACT_LEFT_VIBE,		//Left hand wave[8] + goVibe   -> LINK_CTRL_VIBE (core only)
+	ACT_RIGHT_LED,
+	ACT_RIGHT_VIBE,
+	ACT_EXT_0,			//External devices (eCtrl[0-3])
+	ACT_EXT_1,
+	ACT_EXT_2,
+	ACT_EXT_3,
+	ACT_TARGETS
+};
+
+//Haptic targets are triggers: every write is a new event, even with the same waveform, so they are never de-duplicated.
+//The rest are state targets, where only the latest value matters.
+#define ACT_IS_TRIGGER(target) ((target) == ACT_LOCAL_VIBE || (target) == ACT_LEFT_VIBE || (target) == ACT_RIGHT_VIBE)
+
+//Largest state target payload (led_bank + led_ctrl)
+#define ACT_STATE_MAX 25
+
+//Priorities - higher runs first when the slack does not cover every pending target
+#define ACT_PRIO_LOW 0			//LED scenes
+#define ACT_PRIO_NORMAL 1		//Haptic feedback
+#define ACT_PRIO_HIGH 2			//Alerts
+
+//Default lifetime of a haptic trigger (us). A buzz still pending past it is dropped - it would no longer line up with
+//what caused it. State targets never go stale: their newest write stays pending until it is sent or replaced.
+#define ACT_STALE_US 100000
+
+//Slack kept free after the last actuator transaction, so the next frame's sensor reads start on time (us)
+#define ACT_GUARD_US 500
+
+//Starting cost estimate per transaction until a real one has been measured (us)
+#define ACT_DEFAULT_COST_US 400
+
+//A slower measurement raises a target's cost estimate at once; a faster one only pulls it down by 1/ACT_COST_DECAY of the
+//gap, so one clock-stretched or retried transaction does not price the target out of every later frame
+#define ACT_COST_DECAY 8
+
+//Frames a pending target may be deferred for lack of slack before it is sent anyway (the frame runs a little long
+//instead of the target waiting forever)
+#define ACT_MAX_DEFER 8
+
+//Trigger events one target can hold; any more are counted in stats.coalesced and dropped
+#define ACT_TRIGGER_MAX 4
+
+struct ActuatorSlot
+{
+	bool pending;
+	unsigned char prio;
+
+	//Trigger events still to send (one per actRun, so two buzzes queued in the same frame play on consecutive frames,
+	//each with the waveform in the target's registers when it goes out)
+	unsigned char triggers;
+
+	//When the newest write was queued and when it goes stale (us, triggers only - the whole backlog shares it)
+	unsigned long queued;
+	unsigned long deadline;
+
+	//Frames this target has waited for slack in a row (sent regardless once it reaches ACT_MAX_DEFER)
+	unsigned char deferrals;
+
+	//Bytes last sent to a state target - a pending write with identical bytes is redundant and dropped (unused for triggers)
+	unsigned char lastSent[ACT_STATE_MAX];
+	unsigned char lastLen;
+	bool sentOnce;
+
+	//Transaction time estimate for this target (us, see ACT_COST_DECAY), used to decide whether it fits the slack
+	unsigned short costUs;
+};
+
+struct ActuatorStats
+{
+	//Transactions sent, state writes replaced before they were sent (and triggers past ACT_TRIGGER_MAX), state writes
+	//equal to what was already sent, and stale drops
+	unsigned long sent;
+	unsigned long coalesced;
+	unsigned long redundant;
+	unsigned long stale;
+
+	//Frames where a pending target did not fit the slack and waited for a later frame, and sends forced by ACT_MAX_DEFER
+	unsigned long deferred;
+	unsigned long forced;
+
+	//Frame time with and without actuator traffic in the frame (Welford mean/variance, us)
+	unsigned long loadedFrames;
+	float loadedMean;
+	float loadedM2;
+	unsigned long idleFrames;
+	float idleMean;
+	float idleM2;
+};
+
+struct ActuatorQueue
+{
+	ActuatorSlot slot[ACT_TARGETS];
+
+	//Whether anything was sent this frame (for the loaded/idle frame time split)
+	bool activeThisFrame;
+
+	ActuatorStats stats;
+};
+
+
+	/*
+	* @name:	actInit
+	* @brief:	Clear the queue and load the default cost estimates
+	* @param:	ActuatorQueue &queue 			== Queue state
+	* @return:	void
+	* @type		BOTH
+	*/
+	void actInit(ActuatorQueue &queue);
+
+	/*
+	* @name:	actQueue
+	* @brief:	Mark a target as changed (called by whatever wrote the LED/haptic registers, instead of sending them). Never
+	*			touches a bus. A target that is already pending keeps the higher of the two priorities and the new deadline.
+	*			A state target is replaced by the newer write; a trigger adds one event to the slot's triggers count.
+	* @param:	ActuatorQueue &queue 			== Queue state
+	* @param:	unsigned char target 			== ActuatorTarget
+	* @param:	unsigned char prio 				== ACT_PRIO_*
+	* @param:	unsigned long nowUs 			== micros()
+	* @param:	unsigned long staleUs 			== Trigger lifetime (ACT_STALE_US if the caller has no better figure, ignored for
+	*											   state targets)
+	* @return:	void
+	* @type		BOTH
+	*/
+	void actQueue(ActuatorQueue &queue, unsigned char target, unsigned char prio, unsigned long nowUs, unsigned long staleUs = ACT_STALE_US);
+
+	/*
+	* @name:	actRun
+	* @brief:	STAGE_ACTUATORS body: drop stale triggers and state writes identical to lastSent, then send pending targets
+	*			highest priority first while schedSlackUs covers the target's costUs plus ACT_GUARD_US. A target that does not
+	*			fit stays pending for the next frame, and one deferred ACT_MAX_DEFER frames in a row is sent regardless, so
+	*			the output always ends up at the newest value. Triggers send one event per call. Hand targets only set
+	*			i2c.pendingCtrl (they ride on the next hand request); local ones are written to their device.
+	* @param:	ActuatorQueue &queue 			== Queue state
+	* @param:	FrameScheduler &sched 			== Scheduler state (slack)
+	* @return:	unsigned char sent 				== Targets sent this frame
+	* @type		BOTH
+	* @note:	Runs after the frame's sensor reads are done, so the secondary bus DRV2605 writes never hold up an IMU read
+	*/
+	unsigned char actRun(ActuatorQueue &queue, FrameScheduler &sched);
+
+	/*
+	* @name:	actEndFrame
+	* @brief:	Add the frame time to the loaded or idle statistics and clear activeThisFrame
+	* @param:	ActuatorQueue &queue 			== Queue state
+	* @param:	unsigned long frameUs 			== Time from frame start to the end of the last stage
+	* @return:	void
+	* @type		BOTH
+	*/
+	void actEndFrame(ActuatorQueue &queue, unsigned long frameUs);
+
+	/*
+	* @name:	printActuatorStats
+	* @brief:	Print the counters and the frame time mean/stdev with and without actuator load
+	* @param:	ActuatorQueue &queue 			== Queue state
+	* @return:	void
+	* @type		BOTH
+	*/
+	void printActuatorStats(ActuatorQueue &queue);
+
+#endif
@@ -1,33 +1,100 @@
 #ifndef _SENEX_WIRELESS_H
 #define _SENEX_WIRELESS_H
 
-//Basic Environment Functionality
-#include "Arduino.h"
+#ifdef ARDUINO
+    //Basic Environment Functionality
+    #include "Arduino.h"
 
-//Access to the ESP32 WiFi stack
-#include <esp_WiFi.h>
+    //Access to the ESP32 WiFi stack
+    #include <esp_WiFi.h>
 
-//UDP Sensor broadcast
-#include <WiFiUdp.h>
+    //UDP Sensor broadcast
+    #include <WiFiUdp.h>
 
-//Multicast Beacon for the Suit's search mode
-#include <AsyncUDP.h>
+    //Multicast Beacon for the Suit's search mode
+    #include <AsyncUDP.h>
 
-//Multiple wifi networks
-#include <WiFiMulti.h>
+    //Multiple wifi networks
+    #include <WiFiMulti.h>
 
-//OTA updates for CORE chip
-#include <ArduinoOTA.h>
+    //OTA updates for CORE chip
+    #include <ArduinoOTA.h>
+#else
+    //Host builds only need S_IO and the frame/packet code
+    #include <stdint.h>
+#endif
 
 //Suit-Wide control settings
 #include "Senex_Settings.h"
 
+//Compact body frame encoding for the UDP stream
+#include "Senex_Packet.h"
+
+//Allocation-free debug log ring
+#include "Senex_Log.h"
+
+//Batched quaternion postprocessing
+#include "Senex_Quat.h"
+
+//Bus-health telemetry channel
+#include "Senex_Telemetry.h"
+
+//Lock-free body frame exchange
+#include <atomic>
+
 
 //Task Delays
 #define DEBUG_SEND_DELAY 50
 #define FAST_UDP_DELAY 16
 #define UDP_STREAM_DELAY 16
 
+//Flag in FrameExchange::middle marking a published frame the stream task has not picked up yet
+#define FRAME_FRESH 0x04
+
+
+//One complete body frame, as published by the sampling loop
+typedef struct BodyFrame
+{
+    int32_t finalBodyArray[BODY_ARRAY_SIZE];
+
+    //Joint rotations from quatPostProcess when ctrl_2 bit 4 is set (streamed instead of finalBodyArray)
+    int32_t jointArray[BODY_ARRAY_SIZE];
+
+    //packetOrderNumber and suitTimer at publish time
+    long packetOrderNumber;
+    unsigned long suitTimer;
+
+    //imu_rdy at publish time (which slots hold live data), and imu_slp (which of those are asleep and holding a sample)
+    uint64_t imu_rdy;
+    uint64_t imu_slp;
+
+    //Per-sensor sample times, and the single instant the frame represents when ALIGN_FRAMES is on (core micros)
+    unsigned long sampleStamp[SUIT_SLOTS];
+    unsigned long frameInstant;
+} BodyFrame;
+
+
+//Triple buffer between the sampling loop and streamPacket. The sampler owns "back", the stream task owns "front",
+//and the two swap through "middle" with a single atomic exchange, so neither side ever blocks or sees half a frame.
+typedef struct FrameExchange
+{
+    BodyFrame frame[3];
+
+    //Buffer index being filled (sampler only)
+    unsigned char back;
+
+    //Buffer index ready to hand over, OR'd with FRAME_FRESH when it is newer than front
+    std::atomic<unsigned char> middle;
+
+    //Buffer index being streamed (stream task only)
+    unsigned char front;
+
+    //Frames published, streamed, and overwritten before the stream task got to them
+    unsigned long published;
+    unsigned long streamed;
+    unsigned long skipped;
+} FrameExchange;
+
 
 typedef struct S_IO
 {
@@ -42,7 +109,7 @@ typedef struct S_IO
     * |   3   |   IMU Suit EEPROM bias reset - set to 1 for reset.                              |      X       |
     * |   2   |   IMU right hand EEPROM bias reset - set to 1 for reset.                        |      X       |
     * |   1   |   IMU left hand EEPROM bias reset - set to 1 for reset.                         |      X       |
-    * |   0   |   Set bit to place the system into a lower power state.                         |      X       |
+    * |   0   |   Set bit to place the system into a lower power state (PowerGovernor PWR_LOW). |      X       |
     * ----------------------------------------------------------------------------------------------------------
     */
 
@@ -52,10 +119,10 @@ typedef struct S_IO
     * ----------------------------------------------------------------------------------------------------------
     * |  Bit  |   Meaning                                                                       |  Functional  |
     * ----------------------------------------------------------------------------------------------------------
-    * |   7   |   Set bit to enable Sleep Mode.                                                 |              |
+    * |   7   |   Set bit to enable Sleep Mode (PowerGovernor PWR_SLEEP, wake-on-motion).       |      X       |
     * |   6   |   Set bit to enable LED functionality.                                          |              |
     * |   5   |   Set bit to enable h***** engine.                                              |              |
-    * |   4   |   Set bit to enable ESP32 quaternion postprocessing.                            |              |
+    * |   4   |   Set bit to enable ESP32 quaternion postprocessing.                            |      X       |
     * |   3   |   External device (1) enable.                                                   |              |
     * |   2   |   External device (2) enable.                                                   |              |
     * |   1   |   External device (3) enable.                                                   |              |
@@ -93,6 +160,8 @@ typedef struct S_IO
     * |     1     |     0     |     1     |  Chip is initing + will send data when it has finished  |
     * |     1     |     1     |     0     |  Chip is ready and sending data                         |
     * -----------------------------------------------------------------------------------------------
+    * A ready chip with its imu_slp bit set is asleep (PowerGovernor) - alive, holding its last sample until it moves.
+    * A dead chip drops out of imu_rdy instead.
     */
  	//IMU Enable bitmask (bits 0-35 used)
     //I2C BitMask:          0x000000000000FFFF
@@ -117,16 +186,26 @@ typedef struct S_IO
     //IMU Error bitmask (bits 0-35 used)
     uint64_t imu_err;
 
+    //IMU asleep bitmask (bits 0-35 used, always a subset of imu_rdy)
+    uint64_t imu_slp;
+
+    //Per-sensor frame divider set by the host (index = chipNum, 1 = every frame up to ODR_MAX_DIV, 0 = unchanged)
+    unsigned char imu_odr[36];
+
+    //Sensors whose imu_odr or PWR_LOW state changed and still need setChipODR/planChipODR (applied in STAGE_SETTINGS,
+    //hand chips go out with the next LINK_CTRL_CHIPS request)
+    uint64_t imu_odr_dirty;
+
     //CPU Frequency (normal = 240Mhz)
     unsigned char freqCpu;
 
-    //Simple bank to control LEDS
+    //Simple bank to control LEDS (writers call actQueue(ACT_LOCAL_LED) instead of pushing them out)
     unsigned char led_bank[8][3]; 
 
     //For more advanced LED scenes
     unsigned char led_ctrl;
 
-    //H***** bank
+    //H***** bank (queued with actQueue(ACT_LOCAL_VIBE) - sent from STAGE_ACTUATORS)
     unsigned char bank[130];
 
     //Ctrl registers for 4 external devices
@@ -152,16 +231,28 @@ typedef struct S_IO
     //Keeps track of how long the suit has been operational and provides timestamping for recordings
     unsigned long suitTimer;
 
-    //Stores prototype data packet as data is added
-    long finalBodyArray[105] = {0};
+    //Body frames shared between the sampling loop and streamPacket
+    FrameExchange frames;
+
+    //Stores prototype data packet as data is added (points at frames.frame[frames.back], moved by publishFrame)
+    int32_t * finalBodyArray;
+
+    //Core-clock (micros) sample time of each sensor in the frame being filled (points at frames.frame[frames.back].sampleStamp)
+    unsigned long * sampleStamp;
 
-    //String for debug printouts
-    String logData;
+    //Debug log records, formatted and sent by streamDebugInfo
+    LogRing log;
+
+    //Compact (SXF) stream encoder state (streamPacket only), reset to a keyframe whenever a client connects
+    SXFEncoder sxf;
+
+    //Skeleton and mounting offsets used when ctrl_2 bit 4 (quaternion postprocessing) is set
+    QuatSkeleton skeleton;
 
     //UDP does not recollect packets in any order, this number specifies which ones come first
     bool firstPkt;
 
-    //Send packet data or disable stream to catch whole message
+    //Send packet data or disable stream to catch whole message (unused since FrameExchange, kept for the debug tools)
     bool burnPacket;
 
     //Allow firing of UDP log
@@ -176,8 +267,10 @@ typedef struct S_IO
     bool initFastUDP;
 } S_IO;
 
-#include "Senex_Photonics.h"
-#include "Senex_Vibe.h"
+#ifdef ARDUINO
+    #include "Senex_Photonics.h"
+    #include "Senex_Vibe.h"
+#endif
 
 #ifdef WIFI
     extern I2CBank left_i2c;
@@ -187,12 +280,45 @@ typedef struct S_IO
 void runWifi(void * pvParameters);
 void streamPacket(void * pvParameters);
 void streamDebugInfo(void * pvParameters);
+void telemetryTask(void * pvParameters);
 void fastUDPChannel(void * pvParameters);
 
-void logPrint(S_IO &wirelessIO, String text);
-void logPrint(String text);
-void logPrintln(S_IO &wirelessIO, String text);
-void logPrintln(String text);
+/*
+* @name:    initFrameExchange
+* @brief:   Clear all three body frames and point finalBodyArray/sampleStamp at the first back buffer
+* @param:   S_IO &wirelessIO            == Suit I/O struct
+* @return:  void
+* @type     CORE
+*/
+void initFrameExchange(S_IO &wirelessIO);
+
+/*
+* @name:    publishFrame
+* @brief:   Hand the finished back buffer to the stream task and move finalBodyArray/sampleStamp to a free buffer. Never blocks.
+* @param:   S_IO &wirelessIO            == Suit I/O struct
+* @return:  void
+* @type     CORE
+* @note:    The new back buffer starts as a copy of the raw samples just published, so slots not refreshed next frame keep their
+*           last value. jointArray is not carried - it is rebuilt from the raw samples on every publish.
+*/
+void publishFrame(S_IO &wirelessIO);
+
+/*
+* @name:    latestFrame
+* @brief:   Pick up the newest complete body frame. Never blocks.
+* @param:   S_IO &wirelessIO            == Suit I/O struct
+* @return:  BodyFrame *frame            == Newest frame, or NULL if nothing was published since the last call
+* @type     CORE
+*/
+BodyFrame * latestFrame(S_IO &wirelessIO);
+
+#ifdef ARDUINO
+    //String logging (heap allocates - kept for code outside the sampling loop; PRINT/PRINTLN go through wirelessIO.log)
+    void logPrint(S_IO &wirelessIO, String text);
+    void logPrint(String text);
+    void logPrintln(S_IO &wirelessIO, String text);
+    void logPrintln(String text);
+#endif
 
 class S_Wireless
 {
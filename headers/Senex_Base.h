@@ -1,26 +1,46 @@
 #ifndef _SENEX_BASE_H
 #define _SENEX_BASE_H
 
-#include "Arduino.h"
+#ifdef ARDUINO
+	#include "Arduino.h"
+#endif
 
 #include "Senex_Settings.h"
 
-#include "Wire.h"
+#ifdef ARDUINO
+	#include "Wire.h"
 
-#include <EEPROM.h>
+	#include <EEPROM.h>
+#endif
 
 //Enables/disables SPI type sensors for this microcontroller
-#ifdef IS_SPI
+#if defined IS_SPI && defined ARDUINO
 	#include <SPI.h>
 	#include <avr/wdt.h>
 #endif
 
 #include "Senex_IMU.h"
-#include "Senex_Photonics.h"
-#include "Senex_Vibe.h"
+
+#include "Senex_Scheduler.h"
+
+#include "Senex_HandLink.h"
+
+#include "Senex_BiasStore.h"
+
+#include "Senex_Actuator.h"
+
+#ifdef IS_SPI
+	#include "Senex_SPIPipe.h"
+#endif
+#ifdef ARDUINO
+	#include "Senex_Photonics.h"
+	#include "Senex_Vibe.h"
+#endif
 
 #ifdef CORE
 	#include "Senex_AltCore.h"
+
+	#include "Senex_Power.h"
 #endif
 
 
@@ -41,7 +61,23 @@ class SENEX
 		#endif
 
 	private:
+		//Fixed-period frame timing for coreScheduler/controllerScheduler
+		FrameScheduler sched;
+
+		//LED/haptic writes waiting for frame slack
+		ActuatorQueue actuators;
 
+		#ifdef CORE
+			//Motion-gated sleep/low power for idle sensors
+			PowerGovernor power;
+		#endif
+
+		#if defined CORE && defined ARDUINO
+			//One reader task per I2C bus
+			BusReader primaryReader;
+			BusReader secondaryReader;
+			FrameBarrier barrier;
+		#endif
 };
 
 
@@ -50,6 +86,7 @@ class SENEX
 	@name:	receiveEvent
 	@brief: Master/Slave I2C data recieve interrupt
 	@param: int howMany 		 	== # of bytes expected
+	@note: Only used for HAND_LINK_VERSION 1 cores - handLinkSlaveISR serves the current protocol
 	*/
 	void receiveEvent(int howMany);
 
@@ -57,6 +94,7 @@ class SENEX
 	/*
 	@name:	requestEvent
 	@brief: Master/Slave I2C data request interrupt
+	@note: Only used for HAND_LINK_VERSION 1 cores
 	*/
 	void requestEvent();
 
@@ -70,10 +108,42 @@ class SENEX
 
 #ifdef CORE
 
+	/*
+	@name:	pushHandUpdates
+	@brief: Send a hand's LED/haptic fields - only called from actRun, so it never runs ahead of the sensor reads
+	@param: I2CBank &i2c 			== Hand to update
+	*/
 	void pushHandUpdates(I2CBank &i2c);
 
+	/*
+	@name:	syncHandClock
+	@brief: Two-way time exchange with a hand: core sends t0, hand stamps t1 on receive and t2 on request, core stamps t3.
+			offset = ((t1 - t0) + (t2 - t3)) / 2. Each result goes into the CLOCK_SYNC_WINDOW ring. The good entries (round
+			trip within CLOCK_SYNC_RTT_SLACK_US of the window's shortest) give clockDrift as a least-squares line of offset
+			against t3, and clockOffset/clockOffsetAt come from the newest good entry, so the offset is never older than
+			the last clean exchange and is extrapolated along the drift in between.
+	@param: I2CBank &i2c 			== Hand to sync
+	@return: bool check 			== True if error, false if OK
+	*/
+	bool syncHandClock(I2CBank &i2c);
+
+	/*
+	@name:	handClockOffset
+	@brief: Hand clock minus core clock at a given core time: clockOffset + clockDrift * (coreNow - clockOffsetAt)
+	@param: I2CBank &i2c 			== Hand
+	@param: unsigned long coreNow 	== Core micros() the offset is needed for
+	@return: long offset 			== us
+	*/
+	long handClockOffset(I2CBank &i2c, unsigned long coreNow);
+
 	void updateHand(bool hand, I2CBank &i2c, S_IO &wirelessIO);
 
+	/*
+	@name:	doSuitSettingsUpdate
+	@brief: Apply host control changes: imu_odr_dirty core chips get setChipODR + planChipODR, hand chips are packed into
+			chip_odr and flagged LINK_CTRL_CHIPS. This is the only place an odrDiv is chosen: ODR_MAX_DIV for chips in the power
+			governor's lowMask, imu_odr for the rest.
+	*/
 	void doSuitSettingsUpdate(S_IO &wirelessIO, I2CBank &right_i2c, I2CBank &left_i2c);
 
 	void printSeparatorLine(S_IO &wirelessIO);
@@ -0,0 +1,229 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, or BOTH.        |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+//Log-structured, wear-leveled bias storage (replaces the flat 15 byte per chip EEPROM layout)
+
+#ifndef _SENEX_BIASSTORE_H
+#define _SENEX_BIASSTORE_H
+
+#include <stdint.h>
+
+#include "Senex_Settings.h"
+
+#if defined CORE && defined ARDUINO
+	#include "esp_partition.h"
+#endif
+
+struct ICM20948_BASE;
+
+/* Bias record (BIAS_RECORD_SIZE bytes, appended round-robin through the store):
+* -----------------------------------------------------------------------------------------------------------
+* | Size: (B)		Data 				Description															|
+* -----------------------------------------------------------------------------------------------------------
+* |  1 byte:		Tag 				BIAS_TAG | chipNum (0-35)											|
+* |  2 bytes:		Generation			Per-chip counter, newest record wins (wraps, compared mod 2^16)		|
+* | 12 bytes:		hwAGBias			Accel + gyro hardware bias registers								|
+* |  3 bytes:		magBias				Low byte of each magBias word (same as the old layout)				|
+* |  2 bytes:		CRC-16				CCITT over the 18 bytes above - written last						|
+* -----------------------------------------------------------------------------------------------------------
+* A write that loses power part way fails its CRC on the next boot, so the previous generation for that chip is
+* used. The write pointer moves through the slots in turn but steps over any slot that holds a chip's newest record
+* (liveSlots), so a chip that is rewritten often can never push out another chip's only copy. There are always
+* more slots than chips, so at least BIAS_STORE_SLOTS - 36 (core) / - 10 (hands) slots are free to rotate through.
+*
+* The hands keep the store in AVR EEPROM, which rewrites single bytes. The core keeps it in its own flash partition
+* (PartitionMedium), because the ESP32 EEPROM library is emulated: every commit erases and rewrites the whole sector,
+* so it would wear the same cells on every write and lose every record if power failed during that commit. On the
+* partition a slot is written once between erases (append-only, no commit). Before the write pointer enters a sector,
+* the live records in it are copied forward and only then is the sector erased, so a power loss at any point leaves
+* every chip with a valid record.
+*/
+
+#define BIAS_TAG 0x80
+#define BIAS_TAG_MASK 0xC0
+#define BIAS_RECORD_SIZE 20
+
+//Store header at the start of an EEPROM region ("SB" + layout version). The partition has no header: an erased slot
+//reads 0xFF, which never matches BIAS_TAG.
+#define BIAS_STORE_MAGIC 0x5342
+#define BIAS_STORE_VERSION 1
+#define BIAS_STORE_HEADER 4
+
+//Flash erase unit on the core, and the records that fit in one
+#define BIAS_SECTOR_SIZE 4096
+#define BIAS_SLOTS_PER_SECTOR (BIAS_SECTOR_SIZE / BIAS_RECORD_SIZE)
+
+#ifdef CORE
+	//Data partition (partition table entry with this label, BIAS_PARTITION_SECTORS sectors long)
+	#define BIAS_PARTITION_LABEL "biasstore"
+	#define BIAS_PARTITION_SECTORS 2
+	#define BIAS_STORE_SLOTS (BIAS_PARTITION_SECTORS * BIAS_SLOTS_PER_SECTOR)
+#else
+	#define BIAS_STORE_SLOTS 40
+	#define BIAS_STORE_SIZE (BIAS_STORE_HEADER + BIAS_STORE_SLOTS * BIAS_RECORD_SIZE)
+#endif
+
+//Storage underneath the bias store (EEPROM on the hands, a flash partition on the core, a simulated array with fault
+//injection on a host)
+class S_BiasMedium
+{
+	public:
+		virtual ~S_BiasMedium() {}
+
+		virtual unsigned char read(unsigned short addr) = 0;
+		virtual void write(unsigned short addr, unsigned char data) = 0;
+
+		//Push pending writes to the cells (nothing on AVR EEPROM or the partition)
+		virtual bool commit() = 0;
+
+		//Erase unit in slots (0 = rewritable in place, like AVR EEPROM), and erasing one such block. On a block medium
+		//biasStoreNextSlot relocates a block's live records before it erases it.
+		virtual unsigned short slotsPerBlock() { return 0; }
+		virtual bool eraseBlock(unsigned short block) { return true; }
+};
+
+#if defined CORE && defined ARDUINO
+	//ESP32 flash partition (BIAS_PARTITION_LABEL), written with esp_partition_write and erased a sector at a time.
+	//Slot n lives at (n / BIAS_SLOTS_PER_SECTOR) * BIAS_SECTOR_SIZE + (n % BIAS_SLOTS_PER_SECTOR) * BIAS_RECORD_SIZE.
+	class PartitionMedium : public S_BiasMedium
+	{
+		public:
+			PartitionMedium(void);
+
+			/*
+			* @name:	begin
+			* @brief:	Find the bias partition
+			* @return:	bool check						== True if error (no partition with BIAS_PARTITION_LABEL), false if OK
+			* @type		CORE
+			*/
+			bool begin();
+
+			unsigned char read(unsigned short addr);
+			void write(unsigned short addr, unsigned char data);
+			bool commit();
+			unsigned short slotsPerBlock();
+			bool eraseBlock(unsigned short block);
+
+		private:
+			const esp_partition_t * part;
+	};
+#elif defined ARDUINO
+	class EEPROMMedium : public S_BiasMedium
+	{
+		public:
+			EEPROMMedium(unsigned short start);
+
+			unsigned char read(unsigned short addr);
+			void write(unsigned short addr, unsigned char data);
+			bool commit();
+
+		private:
+			unsigned short start;
+	};
+#endif
+
+//In-RAM view of the store, built by one scan at boot
+struct BiasStore
+{
+	S_BiasMedium * medium;
+
+	//Slot holding the newest valid record for each chip (0xFFFF = none) and that record's generation
+	unsigned short slot[36];
+	unsigned short generation[36];
+
+	//Next slot to write
+	unsigned short writeSlot;
+
+	//Slots holding a chip's newest record (bit = slot) - never picked by biasStoreNextSlot
+	uint32_t liveSlots[(BIAS_STORE_SLOTS + 31) / 32];
+
+	//Chips whose biases changed and still need writing (bit = chipNum), filled by biasStoreQueue
+	uint64_t dirty;
+
+	//Records written, records found with a bad CRC at boot
+	unsigned long writes;
+	unsigned short crcFailures;
+};
+
+
+	/*
+	* @name:	biasStoreOpen
+	* @brief:	Scan every slot once, keep the newest valid record per chip (liveSlots), and find the write pointer. An
+	*			EEPROM region with no store header is migrated from the old flat IMU_EEPROM_SIZE layout first; on the core
+	*			the flat layout is read out of EEPROM once if the partition holds no records yet.
+	* @param:	BiasStore &store 				== Store state
+	* @param:	S_BiasMedium * medium 			== Storage to use
+	* @return:	bool check						== True if error, false if OK
+	* @type		BOTH
+	*/
+	bool biasStoreOpen(BiasStore &store, S_BiasMedium * medium);
+
+	/*
+	* @name:	biasStoreNextSlot
+	* @brief:	Advance writeSlot to the next slot not in liveSlots. biasStoreFlush calls it before every append, then moves
+	*			the chip's liveSlots bit from its old slot to the new one once the record's CRC is written. On a block
+	*			medium, entering a new block first re-appends that block's live records (same generation) further on and
+	*			then erases it.
+	* @param:	BiasStore &store 				== Store state
+	* @return:	unsigned short slot 			== Slot to write next
+	* @type		BOTH
+	* @note:	With one chip rewritten on every flush and another written once, the second chip's record survives any
+	*			number of flushes - the rewritten chip cycles through the free slots only.
+	*/
+	unsigned short biasStoreNextSlot(BiasStore &store);
+
+	/*
+	* @name:	biasStoreLoadAll
+	* @brief:	Warm boot fast path - copy every stored record into its chip and push them all with setChipBiases in one batched pass
+	* @param:	BiasStore &store 				== Store state
+	* @param:	ICM20948_BASE chips[] 			== Chip array
+	* @param:	unsigned char numChips 			== Chips in the array
+	* @param:	uint64_t &chipsLoaded 			== Chips that got stored biases (the rest need a bias search)
+	* @return:	bool check						== True if error, false if OK
+	* @type		BOTH
+	*/
+	bool biasStoreLoadAll(BiasStore &store, ICM20948_BASE chips[], unsigned char numChips, uint64_t &chipsLoaded);
+
+	/*
+	* @name:	biasStoreQueue
+	* @brief:	Mark a chip's biases for writing (called from getDMPBiases - nothing touches EEPROM here)
+	* @param:	BiasStore &store 				== Store state
+	* @param:	ICM20948_BASE &chip 			== Chip with new biases
+	* @return:	void
+	* @type		BOTH
+	*/
+	void biasStoreQueue(BiasStore &store, ICM20948_BASE &chip);
+
+	/*
+	* @name:	biasStoreFlush
+	* @brief:	Append up to maxRecords dirty chips and commit once (run in the scheduler's deferrable EEPROM stage)
+	* @param:	BiasStore &store 				== Store state
+	* @param:	ICM20948_BASE chips[] 			== Chip array
+	* @param:	unsigned char numChips 			== Chips in the array
+	* @param:	unsigned char maxRecords 		== Records allowed this call
+	* @return:	bool check						== True if error, false if OK
+	* @type		BOTH
+	*/
+	bool biasStoreFlush(BiasStore &store, ICM20948_BASE chips[], unsigned char numChips, unsigned char maxRecords);
+
+	/*
+	* @name:	biasStoreErase
+	* @brief:	Drop every record (RESET_EEPROM and the ctrl_1 EEPROM bias reset bits) and free their liveSlots
+	* @param:	BiasStore &store 				== Store state
+	* @param:	uint64_t chipMask 				== Chips to forget (all records for them are invalidated)
+	* @return:	bool check						== True if error, false if OK
+	* @type		BOTH
+	*/
+	bool biasStoreErase(BiasStore &store, uint64_t chipMask);
+
+#endif
@@ -0,0 +1,405 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, or BOTH.        |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+#ifndef _SENEX_BUS_H
+#define _SENEX_BUS_H
+
+#include <stdint.h>
+
+#include "Senex_Settings.h"
+
+struct ICM20948_BASE;
+class TxnQueue;
+
+//Bus timing used by the simulated transport (and for estimates on hardware)
+#define SIM_I2C_CLOCK 400000
+#define SIM_SPI_CLOCK 7000000
+
+//Extra bit times per I2C transaction (start + address byte + ack + stop)
+#define SIM_I2C_OVERHEAD_BITS 20
+
+//ICM20948 model sizes
+#define SIM_BANK_SIZE 128
+#define SIM_DMP_MEM_SIZE 0x4000
+#define SIM_FIFO_SIZE 512
+#define SIM_AK09916_REGS 0x40
+
+//Number of TCA-style muxes per bus (0x70 - 0x73)
+#define SIM_MUX_COUNT 4
+
+//Transaction coalescer sizes (ops per flush, and the shared payload pool they point into)
+#define TXN_QUEUE_SIZE 64
+#define TXN_DATA_SIZE 512
+
+//TxnOp::bank value for a DMP memory write (goes through MEM_BANK_SEL/MEM_START_ADDR instead of REG_BANK_SEL)
+#define TXN_DMP 0xFF
+
+//S_Bus::lastMux value when the routed mux is not known (after a reset or a failed select)
+#define MUX_UNKNOWN 0xFF
+
+//Transaction/byte counters kept by every transport
+struct BusStats
+{
+	//Number of bus transactions (one start/stop or one CS low/high)
+	unsigned long transactions;
+
+	//Payload bytes moved in each direction (register address bytes included in bytesWritten)
+	unsigned long bytesWritten;
+	unsigned long bytesRead;
+
+	//Mux channel writes and ICM20948 bank writes
+	unsigned long muxSelects;
+	unsigned long bankSwitches;
+
+	//Modelled bus time on the simulator, measured time on hardware (us)
+	unsigned long busTimeUs;
+};
+
+
+//Transport underneath write_reg/read_reg/selectMux. write_mems, read_mems, write_mag, read_mag and
+//setBank are all built on write_reg/read_reg, so they go through whatever transport a chip uses.
+class S_Bus
+{
+	public:
+		virtual ~S_Bus() {}
+
+		/*
+		* @name:	writeReg
+		* @brief: 	Raw register write to a single chip
+		* @param: 	ICM20948_BASE &chip 			== Core IMU struct (addr/CSPin/isSecondaryI2C pick the device)
+		* @param: 	unsigned char reg 				== Hardware register address to start write
+		* @param: 	uint32_t len 					== Length of data to be written
+		* @param: 	const unsigned char *data 		== Pointer to char array to write data from
+		* @param: 	bool isDMP 						== Whether the pointer is to a location in ARDX ROM (true) or in system RAM (false)
+		* @return:	bool check						== True if error, false if OK
+		* @type: 	BOTH
+		*/
+		virtual bool writeReg(ICM20948_BASE &chip, unsigned char reg, uint32_t len, const unsigned char *data, bool isDMP) = 0;
+
+		/*
+		* @name:	readReg
+		* @brief: 	Raw register read from a single chip
+		* @param: 	ICM20948_BASE &chip 			== Core IMU struct
+		* @param: 	unsigned char reg 				== Hardware register address to start read
+		* @param: 	uint32_t len 					== Length of data to be read
+		* @param: 	unsigned char *buff 			== Pointer to char array for data output
+		* @return:	bool check						== True if error, false if OK
+		* @type: 	BOTH
+		*/
+		virtual bool readReg(ICM20948_BASE &chip, unsigned char reg, uint32_t len, unsigned char *buff) = 0;
+
+		/*
+		* @name:	selectMux
+		* @brief:	Select a mux channel on one of the two I2C buses
+		* @param:	unsigned char muxAddr 			== I2C address of the mux in question (0x70 - 0x73)
+		* @param:	bool isSecondaryI2C 			== Which physical bus the mux sits on
+		* @return:	bool check						== True if error, false if OK
+		* @type: 	CORE
+		*/
+		virtual bool selectMux(unsigned char muxAddr, bool isSecondaryI2C) = 0;
+
+		/*
+		* @name:	resetMux
+		* @brief: 	Deselect every mux channel on both buses
+		* @return:	void
+		* @type: 	CORE
+		*/
+		virtual void resetMux() = 0;
+
+		/*
+		* @name:	selectMuxGroup
+		* @brief:	Route several mux segments on one bus at the same time (used for broadcast writes)
+		* @param:	unsigned char muxMask 			== Bit n set = route the mux at 0x70 + n
+		* @param:	bool isSecondaryI2C 			== Which physical bus the muxes sit on
+		* @return:	bool check						== True if error, false if OK
+		* @type: 	CORE
+		*/
+		virtual bool selectMuxGroup(unsigned char muxMask, bool isSecondaryI2C) = 0;
+
+		/*
+		* @name:	writeRegBroadcast
+		* @brief: 	Write identical data to several chips in one transfer. On I2C every chip must share an address and
+		*			sit on segments already routed by selectMuxGroup; on SPI every CS line is driven low in lock-step.
+		* @param: 	ICM20948_BASE **chips 			== Chips to write to
+		* @param: 	unsigned char numChips 			== Number of chips
+		* @param: 	unsigned char reg 				== Hardware register address to start write
+		* @param: 	uint32_t len 					== Length of data to be written
+		* @param: 	const unsigned char *data 		== Pointer to char array to write data from
+		* @param: 	bool isDMP 						== Whether the pointer is to a location in ARDX ROM (true) or in system RAM (false)
+		* @return:	bool check						== True if error, false if OK
+		* @type: 	BOTH
+		* @note:	An ACK only proves that one chip listened - a broadcast has to be verified per chip afterwards
+		*/
+		virtual bool writeRegBroadcast(ICM20948_BASE **chips, unsigned char numChips, unsigned char reg, uint32_t len, const unsigned char *data, bool isDMP) = 0;
+
+		//Running totals since the last clearStats(), one per physical bus (index = isSecondaryI2C, SPI uses 0), so on the
+		//core each set is only written by the holder of that bus's lock
+		BusStats stats[2];
+
+		void clearStats();
+
+		//Mux currently routed on each bus (MUX_UNKNOWN if not known). selectMux skips the mux write when it matches.
+		//This is shared by every chip on the bus, unlike ICM20948_BASE::lastBank which is per chip. On the core each entry
+		//is only touched by whoever holds that bus's FrameBarrier::busLock (a reader task or a coreScheduler stage).
+		unsigned char lastMux[2];
+
+		//Batch each bus is writing into (NULL = immediate writes), set by beginBatch. write_reg/write_mems only queue into
+		//the batch of the chip's own bus, so a batch never picks up writes from a task driving the other bus.
+		TxnQueue * batch[2];
+};
+
+
+//One queued write for TxnQueue
+struct TxnOp
+{
+	ICM20948_BASE *chip;
+
+	//Register bank 0-3, or TXN_DMP for a DMP memory write
+	unsigned char bank;
+
+	//Register (bank 0-3) or DMP address (TXN_DMP)
+	unsigned short reg;
+
+	//Where the payload sits in TxnQueue::data, and how long it is
+	unsigned short dataStart;
+	unsigned short len;
+};
+
+
+//Batched write layer. While a queue is active on a bus (beginBatch), write_reg and write_mems for chips on that bus
+//queue instead of touching it. One queue belongs to one bus, and on the core only the holder of that bus's lock
+//batches on it. flush() groups the ops by mux -> chip (a stable grouping - each chip's ops keep their program order,
+//so PWR_MGMT/USER_CTRL sequences, bank selects and repeated writes to one register go out exactly as written). Within
+//a chip, an op is merged into the one before it only when they were queued back to back, in the same bank, and it
+//starts at the address right after the previous one ends. DMP memory writes are also split at 256 byte DMP bank
+//boundaries (one MEM_BANK_SEL/MEM_START_ADDR per bank), whether they were merged or queued that way. Any read on a
+//batched chip flushes first so ordering is kept.
+class TxnQueue
+{
+	public:
+		TxnQueue(void);
+
+		/*
+		* @name:	queueReg
+		* @brief:	Queue a register write
+		* @param:	ICM20948_BASE &chip 			== Core IMU struct
+		* @param:	unsigned char bank 				== Register bank (0-3)
+		* @param:	unsigned char reg 				== Register to start the write
+		* @param:	unsigned short len 				== Length of data
+		* @param:	const unsigned char *data 		== Data to copy into the queue
+		* @return:	bool check						== True if error, false if OK (a full queue flushes itself first)
+		* @type: 	BOTH
+		*/
+		bool queueReg(ICM20948_BASE &chip, unsigned char bank, unsigned char reg, unsigned short len, const unsigned char *data);
+
+		/*
+		* @name:	queueMems
+		* @brief:	Queue a DMP memory write
+		* @param:	ICM20948_BASE &chip 			== Core IMU struct
+		* @param:	unsigned short reg 				== DMP address to start the write
+		* @param:	unsigned short len 				== Length of data
+		* @param:	const unsigned char *data 		== Data to copy into the queue
+		* @return:	bool check						== True if error, false if OK
+		* @type: 	BOTH
+		*/
+		bool queueMems(ICM20948_BASE &chip, unsigned short reg, unsigned short len, const unsigned char *data);
+
+		/*
+		* @name:	flush
+		* @brief:	Group by chip (program order kept per chip), merge back-to-back contiguous writes, split DMP writes at
+		*			DMP bank boundaries and issue them
+		* @return:	bool check						== True if any write failed, false if OK
+		* @type: 	BOTH
+		*/
+		bool flush();
+
+		//Number of ops waiting
+		unsigned char pending();
+
+	private:
+		TxnOp ops[TXN_QUEUE_SIZE];
+		unsigned char numOps;
+
+		unsigned char data[TXN_DATA_SIZE];
+		unsigned short dataUsed;
+};
+
+
+	/*
+	* @name:	beginBatch
+	* @brief:	Route write_reg/write_mems for the chips on one bus into a TxnQueue until endBatch
+	* @param:	TxnQueue &queue 				== Queue to fill (empty, and not active on another bus)
+	* @param:	S_Bus &bus 						== Transport the chips use
+	* @param:	bool isSecondaryI2C 			== Which physical bus (false on SPI)
+	* @return:	void
+	* @type: 	BOTH
+	*/
+	void beginBatch(TxnQueue &queue, S_Bus &bus, bool isSecondaryI2C);
+
+	/*
+	* @name:	endBatch
+	* @brief:	Flush the bus's active queue and go back to immediate writes on that bus
+	* @param:	S_Bus &bus 						== Transport the chips use
+	* @param:	bool isSecondaryI2C 			== Which physical bus (false on SPI)
+	* @return:	bool check						== True if error, false if OK
+	* @type: 	BOTH
+	*/
+	bool endBatch(S_Bus &bus, bool isSecondaryI2C);
+
+
+#ifdef ARDUINO
+	//Wire (core) transport - one TwoWire per physical bus
+	class WireBus : public S_Bus
+	{
+		public:
+			WireBus(TwoWire &primary, TwoWire &secondary);
+
+			bool writeReg(ICM20948_BASE &chip, unsigned char reg, uint32_t len, const unsigned char *data, bool isDMP);
+			bool readReg(ICM20948_BASE &chip, unsigned char reg, uint32_t len, unsigned char *buff);
+			bool selectMux(unsigned char muxAddr, bool isSecondaryI2C);
+			void resetMux();
+			bool selectMuxGroup(unsigned char muxMask, bool isSecondaryI2C);
+			bool writeRegBroadcast(ICM20948_BASE **chips, unsigned char numChips, unsigned char reg, uint32_t len, const unsigned char *data, bool isDMP);
+
+		private:
+			TwoWire *bus[2];
+	};
+
+	//SPI (hand) transport - chips are picked by CSPin
+	class SPIBus : public S_Bus
+	{
+		public:
+			SPIBus(void);
+
+			bool writeReg(ICM20948_BASE &chip, unsigned char reg, uint32_t len, const unsigned char *data, bool isDMP);
+			bool readReg(ICM20948_BASE &chip, unsigned char reg, uint32_t len, unsigned char *buff);
+
+			//No muxes on the hands
+			bool selectMux(unsigned char muxAddr, bool isSecondaryI2C);
+			void resetMux();
+			bool selectMuxGroup(unsigned char muxMask, bool isSecondaryI2C);
+			bool writeRegBroadcast(ICM20948_BASE **chips, unsigned char numChips, unsigned char reg, uint32_t len, const unsigned char *data, bool isDMP);
+	};
+#endif
+
+
+//Software model of a single ICM20948 + AK09916
+struct SimICM20948
+{
+	//Register banks 0-3 (REG_BANK_SEL at 0x7F picks which one is live)
+	unsigned char bank[4][SIM_BANK_SIZE];
+	unsigned char activeBank;
+
+	//DMP memory window (MEM_BANK_SEL 0x7E, MEM_START_ADDR 0x7C, MEM_R_W 0x7D)
+	unsigned char dmpMem[SIM_DMP_MEM_SIZE];
+	unsigned char memBank;
+	unsigned char memAddr;
+
+	//FIFO ring (FIFO_COUNTH/L 0x70/0x71, FIFO_R_W 0x72)
+	unsigned char fifo[SIM_FIFO_SIZE];
+	unsigned short fifoHead;
+	unsigned short fifoCount;
+	bool fifoOverflow;
+
+	//AK09916 registers, reached through the I2C_SLV0/SLV1 aux master in bank 3
+	unsigned char mag[SIM_AK09916_REGS];
+
+	//Bus address (I2C) or CS pin (SPI) the model answers to
+	unsigned char addr;
+	unsigned char CSPin;
+	unsigned char muxAddr;
+	unsigned char muxChannel;
+	bool isSecondaryI2C;
+
+	//Per-chip counters (each chip also adds to the owning SimBus totals)
+	BusStats stats;
+};
+
+
+//Host-side transport backed by SimICM20948 models and a TCA-style mux model on two I2C buses
+class SimBus : public S_Bus
+{
+	public:
+		/*
+		* @name:	SimBus
+		* @brief:	Build a simulated suit bus
+		* @param:	SimICM20948 *chips 				== Array of chip models (owned by the caller)
+		* @param:	unsigned char numChips 			== Number of models in the array
+		* @param:	bool isSPI 						== Charge SPI timing instead of I2C timing
+		* @type: 	BOTH
+		*/
+		SimBus(SimICM20948 *chips, unsigned char numChips, bool isSPI);
+
+		bool writeReg(ICM20948_BASE &chip, unsigned char reg, uint32_t len, const unsigned char *data, bool isDMP);
+		bool readReg(ICM20948_BASE &chip, unsigned char reg, uint32_t len, unsigned char *buff);
+		bool selectMux(unsigned char muxAddr, bool isSecondaryI2C);
+		void resetMux();
+		bool selectMuxGroup(unsigned char muxMask, bool isSecondaryI2C);
+		bool writeRegBroadcast(ICM20948_BASE **chips, unsigned char numChips, unsigned char reg, uint32_t len, const unsigned char *data, bool isDMP);
+
+		/*
+		* @name:	pushFifo
+		* @brief:	Queue canned Ivory Packet bytes into one chip's FIFO (sets the overflow flag past SIM_FIFO_SIZE)
+		* @param:	unsigned char chipNum 			== Index into the model array
+		* @param:	const unsigned char *data 		== Packet bytes
+		* @param:	unsigned short len 				== Number of bytes
+		* @return:	void
+		* @type: 	BOTH
+		*/
+		void pushFifo(unsigned char chipNum, const unsigned char *data, unsigned short len);
+
+		/*
+		* @name:	setNack
+		* @brief:	Make a chip stop acknowledging (error injection for reset/recovery paths)
+		* @param:	unsigned char chipNum 			== Index into the model array
+		* @param:	bool state 						== true = chip NACKs every transaction
+		* @return:	void
+		* @type: 	BOTH
+		*/
+		void setNack(unsigned char chipNum, bool state);
+
+		//Currently selected channel mask for each mux on each bus (0 = nothing routed)
+		unsigned char muxState[2][SIM_MUX_COUNT];
+
+	private:
+		SimICM20948 *chips;
+		unsigned char numChips;
+		bool isSPI;
+		uint64_t nackMask;
+
+		//Find the model a transaction reaches, given the current mux state (NULL if nothing answers)
+		SimICM20948 *route(ICM20948_BASE &chip);
+
+		//Add modelled wire time for one transaction of len bytes
+		void charge(SimICM20948 *model, uint32_t len, bool isRead);
+};
+
+
+	/*
+	* @name:	setBusTransport
+	* @brief:	Set the transport that Start() hands to new chips (WireBus on the core, SPIBus on the hands, SimBus on a host)
+	* @param:	S_Bus *transport 				== Transport to use
+	* @return:	void
+	* @type: 	BOTH
+	*/
+	void setBusTransport(S_Bus *transport);
+
+	/*
+	* @name:	getBusTransport
+	* @brief:	Get the default transport
+	* @return:	S_Bus *transport				== Current default transport
+	* @type: 	BOTH
+	*/
+	S_Bus *getBusTransport();
+
+#endif
@@ -0,0 +1,172 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, or BOTH.        |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+//Hand <-> core I2C link protocol (replaces readCounter/TotalReadCounter paging)
+
+#ifndef _SENEX_HANDLINK_H
+#define _SENEX_HANDLINK_H
+
+#include <stdint.h>
+
+#include "Senex_Settings.h"
+
+/* Core -> hand write (one transaction per frame, control fields piggyback on the read request):
+* -----------------------------------------------------------------------------------------------------------
+* | Size: (B)		In Pkt?		Data 				Description												|
+* -----------------------------------------------------------------------------------------------------------
+* | 1 byte: 		ALWAYS		Version/Flags		High nibble = HAND_LINK_VERSION, low nibble = LINK_CTRL_*	|
+* | 1 byte: 		ALWAYS		Core Sequence		Incremented per request									|
+* | 6 bytes: 		CTRL		Chip Control		chip_en_1/2, chip_rst_1/2, chip_cal_1/2					|
+* | 5 bytes: 		CTRL		Chip ODR			chip_odr - frame divider nibble per chip (setChipODR)		|
+* | 2 bytes: 		CTRL		Chip Sleep			chip_slp_1/2 - chips the core wants asleep (chipSleepWOM)	|
+* | 3 bytes: 		LED			RGB					LEDRed, LEDGreen, LEDBlue								|
+* | 9 bytes: 		VIBE		Haptics				wave[8] + goVibe										|
+* | 4 bytes: 		SYNC		t0					Core micros() for syncHandClock							|
+* | 1 byte: 		ALWAYS		CRC-8				Over everything above									|
+* -----------------------------------------------------------------------------------------------------------
+*
+* Hand -> core read (two phases, length prefixed, only the chips in chipsAlive):
+* -----------------------------------------------------------------------------------------------------------
+* | 1 byte: 		ALWAYS		Length				Bytes that follow, CRC included							|
+* | 1 byte: 		ALWAYS		Hand Sequence		Incremented when new sensor data is in the frame		|
+* | 1 byte: 		ALWAYS		Echo				Core Sequence this frame answers						|
+* | 2 bytes: 		ALWAYS		chipsAlive			Bitmask of the chip records that follow					|
+* | 8 bytes: 		ALWAYS		Chip States			Ready, reset, errored and asleep masks (2 bytes each)	|
+* | 4 bytes: 		ALWAYS		Build Time			Hand micros() when buildHandFrame packed the samples		|
+* | 8 bytes: 		SYNC		t1, t2				Hand micros() on receive and on request					|
+* |14 bytes:		PER CHIP	Sample				12 bytes QUAT9 (big-endian) + 2 bytes sample age			|
+* |									before Build Time (HAND_AGE_UNIT_US units, clamped)		|
+* | 2 bytes: 		ALWAYS		CRC-16				CCITT over everything after Length						|
+* -----------------------------------------------------------------------------------------------------------
+* A sample was taken at Build Time - age on the hand clock, so the core places it with the hand clock offset and
+* the time the frame sat in the buffer before the core read it does not matter.
+* The core first reads the header (Length through Build Time, plus t1/t2 when SYNC was requested). If the Hand
+* Sequence matches the last one the read stops there and the records are never clocked out; otherwise a second read
+* continues from the first record to the CRC. A CRC failure is counted and the hand's slots keep their last value -
+* nothing is ever re-read in the same frame.
+*/
+
+#define HAND_LINK_VERSION 3
+
+//Low nibble of the Version/Flags byte: which optional blocks follow
+#define LINK_CTRL_CHIPS 0x01
+#define LINK_CTRL_LED 0x02
+#define LINK_CTRL_VIBE 0x04
+#define LINK_CTRL_SYNC 0x08
+
+//Hand link clock. The hands sit behind TCA9548A muxes and answer from the AVR TWI, both rated for 400kHz, so that is
+//the default. Fast-mode Plus is only used on boards where it has been verified on the bench (define HAND_I2C_FMPLUS_VERIFIED).
+//readHandFrame switches the bus to this clock for the hand transaction and restores the core bus clock (the rate the
+//bus was running at before, so core IMU reads on the same bus are unaffected) afterwards.
+#ifdef HAND_I2C_FMPLUS_VERIFIED
+	#define HAND_I2C_CLOCK 1000000
+#else
+	#define HAND_I2C_CLOCK 400000
+#endif
+
+//Sample age resolution. 16 bits of 10us cover 655ms, well past the oldest sample an ODR_MAX_DIV chip can hold
+//(about 143ms at 56 fps); anything older is clamped to 0xFFFF rather than wrapping.
+#define HAND_AGE_UNIT_US 10
+#define HAND_AGE_MAX 0xFFFF
+
+#define HAND_LINK_SAMPLE 14
+#define HAND_LINK_HEADER 16
+#define HAND_LINK_SYNC 8
+#define HAND_LINK_REQUEST_MAX 32
+
+//Largest hand frame (every chip alive + sync block + length byte + CRC)
+#define HAND_LINK_FRAME_MAX (1 + HAND_LINK_HEADER + HAND_LINK_SYNC + CONTROLLER_CHIPS * HAND_LINK_SAMPLE + 2)
+
+//Link counters kept per hand on the core
+struct HandLinkStats
+{
+	unsigned long frames;
+	unsigned long staleFrames;
+	unsigned long crcErrors;
+	unsigned long lengthErrors;
+
+	//Core time spent in readHandFrame for the last frame and the worst so far (us)
+	unsigned long readUs;
+	unsigned long worstReadUs;
+};
+
+
+	/*
+	* @name:	crc8
+	* @brief:	CRC-8 (poly 0x07) for the core -> hand request
+	* @param:	const unsigned char * data 		== Bytes to check
+	* @param:	unsigned char len 				== Number of bytes
+	* @return:	unsigned char crc
+	* @type		BOTH
+	*/
+	unsigned char crc8(const unsigned char * data, unsigned char len);
+
+	/*
+	* @name:	crc16
+	* @brief:	CRC-16/CCITT for the hand -> core frame
+	* @param:	const unsigned char * data 		== Bytes to check
+	* @param:	unsigned short len 				== Number of bytes
+	* @return:	unsigned short crc
+	* @type		BOTH
+	*/
+	unsigned short crc16(const unsigned char * data, unsigned short len);
+
+
+#ifdef CORE
+	/*
+	* @name:	readHandFrame
+	* @brief:	Write the request (with any pending doSuitSettingsUpdate fields piggybacked) and read the hand frame back
+	*			at HAND_I2C_CLOCK: the header first, then the records only if the Hand Sequence is new. The core bus clock
+	*			is restored before returning. Replaces getHandPacket's paged reads.
+	* @param:	I2CBank &i2c 					== One of two (L/R) hand structs
+	* @param:	uint64_t &sensorReset 			== Bitmap of the chips that need to be reset
+	* @param:	uint64_t &sensorReady 			== Bitmap of the chips that are now ready to send data
+	* @param:	uint64_t &sensorErrored 		== Bitmap of the chips that errored
+	* @param:	uint64_t &sensorAsleep 			== Bitmap of the chips asleep on the hand (a cleared bit = woken, see powerWake)
+	* @param:	int32_t * finalBodyArray		== Body frame - only the alive chips' slots are written
+	* @param:	unsigned long * sampleStamp 	== Core-clock sample time of each sensor
+	* @param:	HandLinkStats &stats 			== Per-hand link counters
+	* @return:	bool check						== True if error (NACK, bad length or CRC), false if OK
+	* @type		CORE
+	*/
+	bool readHandFrame(I2CBank &i2c, uint64_t &sensorReset, uint64_t &sensorReady, uint64_t &sensorErrored, uint64_t &sensorAsleep, int32_t * finalBodyArray, unsigned long * sampleStamp, HandLinkStats &stats);
+#endif
+
+#ifndef CORE
+	/*
+	* @name:	buildHandFrame
+	* @brief:	Pack the alive chips into the outgoing frame once per controller frame (outside the I2C interrupt)
+	* @param:	unsigned char * frame 			== HAND_LINK_FRAME_MAX byte buffer (double buffered with the one being sent)
+	* @param:	unsigned char * HandArray		== Quaternion slots filled by SPIPipe
+	* @param:	unsigned short chipsAlive		== Chips to include
+	* @param:	unsigned short chipsReady		== Ready mask
+	* @param:	unsigned short chipsReset		== Reset mask
+	* @param:	unsigned short chipsErrored		== Error mask
+	* @param:	unsigned short chipsAsleep		== Chips in chipSleepWOM (a bit drops as soon as the chip wakes on motion)
+	* @return:	unsigned char len 				== Frame length
+	* @type		CONTROLLER
+	*/
+	unsigned char buildHandFrame(unsigned char * frame, unsigned char * HandArray, unsigned short chipsAlive, unsigned short chipsReady, unsigned short chipsReset, unsigned short chipsErrored, unsigned short chipsAsleep);
+
+	/*
+	* @name:	handLinkSlaveISR
+	* @brief:	TWI slave interrupt that streams the finished frame byte by byte straight from its buffer, so the header and the
+	*			records each go out in one read without being limited by the 32 byte Wire buffer. Requests are CRC-checked here and handed
+	*			to doControlUpdate.
+	* @return:	void
+	* @type		CONTROLLER
+	*/
+	void handLinkSlaveISR();
+#endif
+
+#endif
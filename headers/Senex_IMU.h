@@ -14,28 +14,107 @@
 #ifndef _SENEX_IMU_H
 #define _SENEX_IMU_H
 
-#include "Arduino.h"
+#ifdef ARDUINO
+	#include "Arduino.h"
+#else
+	//Host builds (syntax checks and simulation) - only the fixed-width types are needed, no Arduino stubs
+	#include <stdint.h>
+#endif
 
 #include "Senex_Settings.h"
 
-#include "Math.h"
+#ifdef ARDUINO
+	#include "Math.h"
 
-#include "Wire.h"
+	#include "Wire.h"
 
-#include <EEPROM.h>
+	#include <EEPROM.h>
+#else
+	#include <math.h>
+#endif
 
 #include "Senex_Base.h"
 
+#include "Senex_Bus.h"
+
 #ifdef CORE
 	#include "Senex_AltCore.h"
 #endif
 
 //Enables/disables SPI type sensors for this microcontroller
-#ifdef IS_SPI
+#if defined IS_SPI && defined ARDUINO
     #include <SPI.h>
     #include <avr/wdt.h>
 #endif
 
+//Ivory Packet Header1 bits that change the length of a packet
+#define IVORY_H1_QUAT6 0x0800
+#define IVORY_H1_QUAT9 0x0400
+#define IVORY_H1_HEADER2 0x0008
+
+//Ivory Packet Header2 bits (each one adds a 2 byte accuracy word to the end of the packet)
+#define IVORY_H2_ACCEL_ACC 0x4000
+#define IVORY_H2_GYRO_ACC 0x2000
+#define IVORY_H2_CPASS_ACC 0x1000
+
+//Size of the FIFO burst buffer (the full ICM20948 FIFO, so one read can empty it)
+#define IVORY_DRAIN_SIZE 512
+
+//Most quaternions a single drain will hand back (512B / 14B, the smallest packet: 2B header + 12B QUAT6)
+#define IVORY_MAX_PACKETS 36
+
+//DMP image layout (14301B written in 16B lines starting at DMP address 0x90)
+#define DMP_IMAGE_SIZE 14301
+#define DMP_LOAD_START 0x90
+#define DMP_FLASH_CHUNK 16
+
+//Warm-start signature block in unused DMP memory past the image (image CRC, config hash, chipNum, magic).
+//The config hash covers the FSRs, the mounting matrix and odrDiv, so a chip set up for another rate is fully re-inited.
+#define DMP_SIGNATURE_ADDR 0x3FF0
+#define DMP_SIGNATURE_SIZE 16
+#define DMP_SIGNATURE_MAGIC 0x53584457
+
+//Image lines spot-checked against flash by probeChipWarm on top of the signature
+#define WARM_SPOT_CHECKS 4
+
+//DMP output rate registers (DMP memory). The DMP runs at DMP_RATE_HZ and writes a quaternion every (register + 1) runs.
+#define DMP_RATE_HZ 225
+#define DMP_ODR_QUAT6 0xAC
+#define DMP_ODR_QUAT9 0xA8
+#define DMP_ODR_CNTR_QUAT6 0x9C
+#define DMP_ODR_CNTR_QUAT9 0x98
+
+//ODR register for a frame divider: ceil(DMP_RATE_HZ * odrDiv / ODR_TICK_HZ) - 1, rounded up so the DMP never writes
+//quaternions faster than the chip is read
+#define DMP_ODR_REG(odrDiv) ((DMP_RATE_HZ * (odrDiv) + ODR_TICK_HZ - 1) / ODR_TICK_HZ - 1)
+
+//Indexes into DMPFlashReport (one per physical bus)
+#define FLASH_BUS_PRIMARY 0
+#define FLASH_BUS_SECONDARY 1
+#define FLASH_BUS_SPI 2
+
+//Steps of the resumable chip reset (ICM20948_BASE::resetStage)
+enum ResetStage
+{
+	RST_IDLE,
+	RST_CLEAR_DMP,		//clearDMP
+	RST_FLASH,			//DMP image, DMP_FLASH_CHUNK bytes per step (resetStep = next line)
+	RST_VERIFY,			//verifyImageCRC, in chunks
+	RST_CONFIG,			//setAccGyroFSR, initChipMatricies, DMPGetSF
+	RST_ODR,			//setChipODR(chip, chip.odrDiv) - odrDueMask assumes the DMP already runs at this rate
+	RST_MAG,			//setMag
+	RST_AUX_BUS,		//setAuxI2CBus
+	RST_BIASES,			//setChipBiases
+	RST_FIFO_TEST,		//testFifo, retried up to RESET_MAX_RETRIES times
+	RST_SIGNATURE,		//writeWarmSignature, so chips recovered here can warm-start next time
+	RST_DONE,
+	RST_FAILED
+};
+
+//Packet length lookup tables, indexed by the compressed header keys from ivoryH1Key/ivoryH2Key
+extern const unsigned char ivoryH1Length[8];
+extern const unsigned char ivoryH2Length[8];
+
 //This is a general struct for each sensor.
 //It contains all relevant data needed for sensor operation.
 struct ICM20948_BASE
@@ -67,7 +146,7 @@ struct ICM20948_BASE
 	//Enable/Disable for core DMP Loop
 	bool DMPLP;
 
-	//Enable/Disable IMU sleep
+	//Enable/Disable IMU sleep (set while the chip is in chipSleepWOM)
 	bool asleep;
 
 	//Enable/Disable DMP/FIFO Data Collection (Effectively makes the chip dissapear - it won't get read from)
@@ -103,8 +182,64 @@ struct ICM20948_BASE
 	//Which physical pin to use for SPI CS on hands
 	unsigned char CSPin;
 
+	//////////TRANSPORT//////////
+
+	//Bus the chip is reached through (set by Start from getBusTransport())
+	S_Bus *bus;
+
+	//Transactions/bytes issued for this chip alone (the transport keeps the bus-wide totals)
+	BusStats busStats;
+
+	//////////RESET STATE//////////
+
+	//Where the chip is in its reset (ResetStage), progress inside that stage, and testFifo retries so far
+	unsigned char resetStage;
+	unsigned short resetStep;
+	unsigned char resetRetries;
+
+	//When the current reset started, how long the last one took, and how many resets this chip has had (ms)
+	unsigned long resetStartTime;
+	unsigned long lastRecoveryTime;
+	unsigned short resetCount;
+
+	//////////OUTPUT DATA RATE//////////
+
+	//Frames between reads (1 = every frame, up to ODR_MAX_DIV), and the frame of that cycle the chip is read on
+	unsigned char odrDiv;
+	unsigned char odrPhase;
+
 	//Raw DMP3 output (QUAT9)
 	long sensorOutput[3];
+
+	//micros() (local clock) when sensorOutput was read out of the FIFO
+	unsigned long sampleTime;
+};
+
+//Suit-wide effect of resets on the frame rate
+struct ResetMetrics
+{
+	//Frames that ran while at least one chip was recovering, and the frame rate during them
+	unsigned long framesRecovering;
+	unsigned long worstFrameUs;
+	unsigned short minFps;
+
+	//Longest single chip recovery (ms) and which chip it was
+	unsigned long worstRecoveryTime;
+	unsigned char worstRecoveryChip;
+};
+
+//Per-bus results from DMPFlashParallel, for the boot-time report
+struct DMPFlashReport
+{
+	//Wall time spent flashing + verifying on each bus (us)
+	unsigned long busTimeUs[3];
+
+	//Chips that passed/failed the CRC readback on each bus
+	unsigned char chipsFlashed[3];
+	unsigned char chipsFailed[3];
+
+	//Broadcast transfers issued on each bus (one per 16B line per group)
+	unsigned short transfers[3];
 };
 
 bool setChipBiases(ICM20948_BASE &chip);
@@ -121,6 +256,7 @@ bool setChipBiases(ICM20948_BASE &chip);
 	* @param:	unsigned char sensNum			== Sets specific device parameters. Each sensor must have a unique ID
 	* @return:	void
 	* @type: 	BOTH
+	* @note:	chip.bus is set to the current getBusTransport()
 	*/
 	void Start(ICM20948_BASE &chip, unsigned char sensNum);
 
@@ -139,6 +275,7 @@ bool setChipBiases(ICM20948_BASE &chip);
 	* @param:	bool isSecondaryI2C 			== Figure out chich channel to pass through to
 	* @return:	bool check						== True if error, false if OK
 	* @type: 	CORE
+	* @note:	No bus write if the transport's lastMux already matches
 	*/
 	bool selectMux(unsigned char muxAddr, bool isSecondaryI2C);
 
@@ -162,9 +299,50 @@ bool setChipBiases(ICM20948_BASE &chip);
 	* @return:	bool check						== True if error, false if OK
 	* @type		BOTH
 	* @note:	TESTED GOOD AS OF: JAN 27 2021
+	*			With WARM_START and isWarmBoot(), warmStartSensor is tried first and the full init only runs if it fails.
+	*			A full init ends with writeWarmSignature. The DMP output rate comes from chip.odrDiv (setChipODR).
 	*/
 	bool setSensor(ICM20948_BASE &chip, bool doRetry = false);
 
+	/*
+	* @name:	isWarmBoot
+	* @brief: 	Whether this was a CPU-only reset (watchdog/software/ctrl_1 controller reset) with the IMUs left powered
+	* @return:	bool warm						== True for a CPU-only reset, false for power-on or brown-out
+	* @type		BOTH
+	*/
+	bool isWarmBoot();
+
+	/*
+	* @name:	probeChipWarm
+	* @brief: 	Check that a chip still holds a valid DMP image and configuration: WHO_AM_I, power/USER_CTRL state, FSRs and
+	*			DMP start address match, the signature block matches DMPImageCRC() and this chip's config, and
+	*			WARM_SPOT_CHECKS image lines read back equal to flash
+	* @param: 	ICM20948 &chip 					== Core IMU struct (lastBank is re-read, not trusted)
+	* @return:	bool check						== True if the chip needs a full init, false if it can be resumed
+	* @type		BOTH
+	*/
+	bool probeChipWarm(ICM20948_BASE &chip);
+
+	/*
+	* @name:	warmStartSensor
+	* @brief: 	Resume a chip that passed probeChipWarm: restore the struct state (FSRs, biases, odrDiv), FIFO reset and DMP
+	*			reset only
+	* @param: 	ICM20948 &chip 					== Core IMU struct
+	* @return:	bool check						== True if the probe or resume failed (run the full setSensor), false if streaming
+	* @type		BOTH
+	*/
+	bool warmStartSensor(ICM20948_BASE &chip);
+
+	/*
+	* @name:	writeWarmSignature
+	* @brief: 	Write the signature block after a successful full init or stepped reset (RST_SIGNATURE), cleared again by
+	*			clearDMP
+	* @param: 	ICM20948 &chip 					== Core IMU struct
+	* @return:	bool check						== True if error, false if OK
+	* @type		BOTH
+	*/
+	bool writeWarmSignature(ICM20948_BASE &chip);
+
 	/*
 	* @name:	setSensorHelper
 	* @brief: 	Init ICM20948 9-Axis IMU to QUAT9 DMP Output
@@ -176,6 +354,43 @@ bool setChipBiases(ICM20948_BASE &chip);
 	*/
 	bool setSensorHelper(ICM20948_BASE &chip);
 
+	/*
+	* @name:	setChipODR
+	* @brief:	Set how often a chip is read (every odrDiv frames) and program the DMP quaternion ODR register to match, so
+	*			the FIFO only fills as fast as it is emptied. Safe to call while the chip is streaming.
+	* @param:	ICM20948_BASE &chip 			== Core IMU struct
+	* @param:	unsigned char odrDiv 			== Frame divider (1 to ODR_MAX_DIV, anything else is clamped)
+	* @return:	bool check						== True if error, false if OK
+	* @type		BOTH
+	* @note:	Register value is DMP_ODR_REG(odrDiv), i.e. DMP_RATE_HZ * odrDiv / ODR_TICK_HZ rounded up, minus 1. Rounding
+	*			up keeps the DMP output at or below the read rate (at 56 fps and odrDiv 1 that is register 4, 45 Hz,
+	*			rather than register 3, 56.25 Hz). The ODR counter is cleared with it so the new rate starts on the next DMP run
+	*/
+	bool setChipODR(ICM20948_BASE &chip, unsigned char odrDiv);
+
+	/*
+	* @name:	planChipODR
+	* @brief:	Give every chip an odrPhase so slow chips are spread over the frames of their cycle instead of all landing on
+	*			the same one. Re-run whenever an odrDiv changes.
+	* @param:	struct ICM20948_BASE chips[]	== Chip array
+	* @param:	unsigned char numChips 			== Chips in the array
+	* @return:	unsigned char peak 				== Most chips read in any one frame (the bus load the tick has to fit)
+	* @type		BOTH
+	*/
+	unsigned char planChipODR(struct ICM20948_BASE chips[], unsigned char numChips);
+
+	/*
+	* @name:	odrDueMask
+	* @brief:	Chips due to be read this frame (frameCount % odrDiv == odrPhase)
+	* @param:	struct ICM20948_BASE chips[]	== Chip array
+	* @param:	unsigned char numChips 			== Chips in the array
+	* @param:	unsigned long frameCount 		== FrameScheduler::frames
+	* @return:	uint64_t mask 					== Bit = chipNum (controller masks use maskPlace, see the CONTROLLER note)
+	* @type		BOTH
+	* @note:	On the controllers only the low 16 bits are used, with bit = maskPlace so it lines up with chipsEnabled
+	*/
+	uint64_t odrDueMask(struct ICM20948_BASE chips[], unsigned char numChips, unsigned long frameCount);
+
 	/*
 	* @name:	setMag
 	* @brief:	Set up the magnometer when initing the DMP
@@ -240,6 +455,8 @@ bool setChipBiases(ICM20948_BASE &chip);
 	* @param:	ICM20948_BASE &chip 			== Core IMU struct
 	* @return:	bool check						== True if error, false if OK
 	* @type		BOTH
+	* @note:	Batched (beginBatch/endBatch) - the writes go out in program order in one flush, and only the ones queued back
+	*			to back at adjacent registers of the same bank merge into a burst
 	*/
 	bool setAccGyroFSR(ICM20948_BASE &chip, unsigned char accelFSR = 1, unsigned char gyroFSR = 3);
 
@@ -279,15 +496,61 @@ bool setChipBiases(ICM20948_BASE &chip);
 	* @param:	ICM20948_BASE &chip 			== Core IMU struct
 	* @return:	bool check						== True if error, false if OK
 	* @type		BOTH
+	* @note:	Debug printout only - flash verification is done by verifyImageCRC
 	*/
 	bool readImage(ICM20948_BASE &chip);
 
+	/*
+	* @name:	DMPFlashParallel
+	* @brief:	Flash the DMP image to every chip in chipMask at once. Chips are grouped by bus and address; each group gets
+	*			every 16B line in one broadcast transfer (all of its mux segments routed together on I2C, all CS lines low
+	*			together on SPI), and the primary and secondary I2C buses are interleaved line by line.
+	*			Every chip is then checked with a single verifyImageCRC pass.
+	* @param:	ICM20948_BASE chips[]			== Array of IMU structs
+	* @param:	unsigned char numChips			== Number of chips in the array
+	* @param:	uint64_t chipMask				== Chips to flash (bit = chipNum)
+	* @param:	uint64_t &chipsFailed			== Bits set for chips that failed the CRC readback (retry these with DMPFlashImage)
+	* @param:	DMPFlashReport &report			== Per-bus time and counts
+	* @return:	bool check						== True if error, false if OK
+	* @type		BOTH
+	*/
+	bool DMPFlashParallel(ICM20948_BASE chips[], unsigned char numChips, uint64_t chipMask, uint64_t &chipsFailed, DMPFlashReport &report);
+
+	/*
+	* @name:	DMPImageCRC
+	* @brief:	CRC-32 of the DMP image held in flash (computed once and cached)
+	* @return:	uint32_t crc 					== Expected CRC of a correctly flashed chip
+	* @type		BOTH
+	*/
+	uint32_t DMPImageCRC();
+
+	/*
+	* @name:	verifyImageCRC
+	* @brief:	Read the DMP image back in one pass, CRCing it as it streams in (nothing is buffered)
+	* @param:	ICM20948_BASE &chip 			== Core IMU struct
+	* @param:	uint32_t &crc 					== CRC of what the chip holds
+	* @return:	bool check						== True if error or CRC mismatch, false if OK
+	* @type		BOTH
+	*/
+	bool verifyImageCRC(ICM20948_BASE &chip, uint32_t &crc);
+
+	/*
+	* @name:	printFlashReport
+	* @brief:	Boot-time benchmark printout of DMPFlashParallel (time, transfers and failures per bus)
+	* @param:	DMPFlashReport &report			== Report to print
+	* @return:	void
+	* @type		BOTH
+	*/
+	void printFlashReport(DMPFlashReport &report);
+
 	/*
 	* @name:	initChipMatricies
 	* @brief:	Send DMP mounting matricies of the compass and the B2S feature
 	* @param:	ICM20948_BASE &chip 			== Core IMU struct
 	* @return:	bool check						== True if error, false if OK
 	* @type		BOTH
+	* @note:	Batched - matrix writes queued back to back at adjacent DMP addresses merge into one burst, split at
+	*			256 byte DMP bank boundaries
 	*/
 	bool initChipMatricies(ICM20948_BASE &chip);
 
@@ -297,6 +560,7 @@ bool setChipBiases(ICM20948_BASE &chip);
 	* @param:	ICM20948_BASE &chip 			== Core IMU struct
 	* @return:	bool check						== True if error, false if OK
 	* @type		BOTH
+	* @note:	Batched with the rest of the DMP config writes
 	*/
 	bool DMPGetSF(ICM20948_BASE &chip);
 
@@ -321,6 +585,7 @@ bool setChipBiases(ICM20948_BASE &chip);
 	* @param:	bool printResults 				== Choose whether to print the results of the calibration
 	* @return:	bool check						== True if error, false if OK
 	* @type		BOTH
+	* @note:	New biases are queued with biasStoreQueue and written later by biasStoreFlush
 	*/
 	bool getDMPBiases(ICM20948_BASE &chip, bool printResults);
 
@@ -335,7 +600,7 @@ bool setChipBiases(ICM20948_BASE &chip);
 
 	/*
 	* @name:	debugBiasEEPROM
-	* @brief:	Debug readout of the entire EEPROM space used for bias corrections/saves on power off
+	* @brief:	Debug readout of the entire EEPROM space used for bias corrections/saves on power off (slot, chip, generation, CRC state)
 	* @return:	void
 	* @type		BOTH
 	*/
@@ -348,7 +613,7 @@ bool setChipBiases(ICM20948_BASE &chip);
 
 	/*
 	* @name:	write_reg
-	* @brief: 	Base I2C write to ICM20948
+	* @brief: 	Base I2C/SPI write to ICM20948 through chip.bus
 	* @param: 	ICM20948 &chip 					== Core IMU struct
 	* @param: 	unsigned char reg 				== Hardware register address to start write
 	* @param: 	uint32_t len 					== Length of data to be written
@@ -357,12 +622,13 @@ bool setChipBiases(ICM20948_BASE &chip);
 	* @return:	bool check						== True if error, false if OK
 	* @type: 	BOTH
 	* @note:	TESTED GOOD AS OF: DEC 19 2020
+	*			NACKs and retries are counted in telemetry[telemetryWriter()].chip[chip.chipNum] (core only)
 	*/
 	bool write_reg(ICM20948_BASE &chip, unsigned char reg, uint32_t len, const unsigned char *data, bool isDMP = false);
 
 	/*
 	* @name:	read_reg
-	* @brief: 	Base I2C read to ICM20948
+	* @brief: 	Base I2C/SPI read to ICM20948 through chip.bus
 	* @param: 	ICM20948 &chip 					== Core IMU struct
 	* @param: 	unsigned char reg 				== Start address in DMP to read from
 	* @param: 	uint32_t length 				== Length of data to be read (>1 for burst write)
@@ -370,6 +636,8 @@ bool setChipBiases(ICM20948_BASE &chip);
 	* @return:	bool check						== True if error, false if OK
 	* @type: 	BOTH
 	* @note:	TESTED GOOD AS OF: DEC 19 2020
+	*			NACKs, retries and FIFO overflow flags are counted in telemetry[telemetryWriter()].chip[chip.chipNum]
+	*			(core only)
 	*/
 	bool read_reg(ICM20948_BASE &chip, unsigned char reg, uint32_t len, unsigned char *buff);
 
@@ -454,9 +722,45 @@ bool setChipBiases(ICM20948_BASE &chip);
 	*/
 	bool IMUSleep(ICM20948_BASE &chip, bool state);
 
+	/*
+	* @name:	chipLowPower
+	* @brief: 	Low-power DMP operation for an idle chip: fullPower(false) between DMP runs. The read rate is not changed
+	*			here - doSuitSettingsUpdate owns odrDiv (see PowerGovernor).
+	* @param: 	ICM20948 &chip 					== Core IMU struct
+	* @param: 	bool state						== true = low power, false = back to full power
+	* @return:	bool check						== True if error, false if OK
+	* @type: 	BOTH
+	*/
+	bool chipLowPower(ICM20948_BASE &chip, bool state);
+
+	/*
+	* @name:	chipSleepWOM
+	* @brief: 	Sleep a chip with wake-on-motion armed: DMP, gyro and mag off, accel duty-cycled with ACCEL_WOM_THR set and the
+	*			WOM interrupt latched in INT_STATUS. Waking turns the gyro/DMP back on and resets the FIFO (the DMP image and
+	*			biases stay resident, so there is no reflash).
+	* @param: 	ICM20948 &chip 					== Core IMU struct
+	* @param: 	bool state						== true = sleep with WOM armed, false = wake
+	* @param: 	unsigned char thresholdMg 		== WOM threshold (POWER_WOM_MG)
+	* @return:	bool check						== True if error, false if OK
+	* @type: 	BOTH
+	* @note:	Sets chip.asleep. IMUSleep would stop the accelerometer too, so it is not used here.
+	*/
+	bool chipSleepWOM(ICM20948_BASE &chip, bool state, unsigned char thresholdMg);
+
+	/*
+	* @name:	chipWomFired
+	* @brief: 	Read (and clear) the WOM bit of a sleeping chip - one register read, done in place of its FIFO read every
+	*			POWER_WOM_POLL frames
+	* @param: 	ICM20948 &chip 					== Core IMU struct
+	* @param: 	bool &fired 					== True if the chip saw motion
+	* @return:	bool check						== True if error, false if OK
+	* @type: 	BOTH
+	*/
+	bool chipWomFired(ICM20948_BASE &chip, bool &fired);
+
 	/*
 	* @name:	setBank
-	* @brief:	Set the ICM20948's bank (0-3)
+	* @brief:	Set the ICM20948's bank (0-3). Inside a batch this only tags the queued writes - TxnQueue::flush issues the bank writes
 	* @param:	ICM20948_BASE &chip 			== Core IMU struct
 	* @param:	unsigned char bank 				== The bank to switch to
 	* @return:	bool check						== True if error, false if OK
@@ -476,7 +780,8 @@ bool setChipBiases(ICM20948_BASE &chip);
 
 	/*
 	* @name:	updateCoreChipReset
-	* @brief:	Check if any chips need to be reset, and if so, reset them (if core chip), set reset bytes (if controller chip), and update Wifi registers
+	* @brief:	Check if any chips need to be reset, and if so, reset them (if core chip), set reset bytes (if controller chip), and update Wifi registers.
+	*			When more than one chip is reset in the same call, their images are flashed together with DMPFlashParallel
 	* @param:	struct ICM20948_BASE chips[10]	== Array of Core IMU structs
 	* @param:	uint64_t &chipsReset 			== Reset bitmap
 	* @param:	uint64_t &chipsReady			== Ready bitmap
@@ -498,6 +803,45 @@ bool setChipBiases(ICM20948_BASE &chip);
 	*/
 	bool updateControllerChipReset(struct ICM20948_BASE chips[CONTROLLER_CHIPS], unsigned short &chipsReset, unsigned short &chipsReady, unsigned short &chipsError);
 
+	/*
+	* @name:	stepChipReset
+	* @brief:	Advance one chip's reset by at most txnBudget bus transactions, resuming where the last call stopped
+	* @param:	ICM20948_BASE &chip 			== Core IMU struct
+	* @param:	unsigned char txnBudget 		== Bus transactions allowed this call (RESET_TXN_BUDGET per frame)
+	* @return:	unsigned char stage 			== ResetStage after this step (RST_DONE or RST_FAILED when finished)
+	* @type		BOTH
+	*/
+	unsigned char stepChipReset(ICM20948_BASE &chip, unsigned char txnBudget);
+
+	/*
+	* @name:	updateCoreChipResetStep
+	* @brief:	Non-blocking updateCoreChipReset. New bits in chipsReset start a reset (imu_rdy cleared, imu_cal set - "initing"),
+	*			one chip gets a stepChipReset per frame in round-robin order, and finished chips move to chipsReady or chipsErrored.
+	*			Healthy chips keep streaming the whole time.
+	* @param:	struct ICM20948_BASE chips[15]	== Array of Core IMU structs
+	* @param:	uint64_t &chipsReset 			== Reset bitmap (bits clear as resets finish)
+	* @param:	uint64_t &chipsReady			== Ready bitmap
+	* @param:	uint64_t &chipsErrored			== Error bitmap
+	* @param:	uint64_t &chipsCal				== imu_cal bitmap (set while a chip is initing)
+	* @param:	ResetMetrics &metrics			== Recovery time and frame-rate dip
+	* @return:	bool check						== True if error, false if OK
+	* @type		CORE
+	*/
+	bool updateCoreChipResetStep(struct ICM20948_BASE chips[CORE_CHIPS], uint64_t &chipsReset, uint64_t &chipsReady, uint64_t &chipsErrored, uint64_t &chipsCal, ResetMetrics &metrics);
+
+	/*
+	* @name:	updateControllerChipResetStep
+	* @brief:	Non-blocking updateControllerChipReset, stepped once per controller frame
+	* @param:	struct ICM20948_BASE chips[10]	== Array of Controller IMU structs
+	* @param:	unsigned short &chipsReset		== Chips still resetting (bits clear as resets finish)
+	* @param: 	unsigned short &chipsReady		== Chips that finished get set here
+	* @param:	unsigned short &chipsError		== Bit set if chip fails reset
+	* @param:	ResetMetrics &metrics			== Recovery time and frame-rate dip
+	* @return:	bool check						== True if error, false if OK
+	* @type		CONTROLLER
+	*/
+	bool updateControllerChipResetStep(struct ICM20948_BASE chips[CONTROLLER_CHIPS], unsigned short &chipsReset, unsigned short &chipsReady, unsigned short &chipsError, ResetMetrics &metrics);
+
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 //										  IVORY PACKET										   //
@@ -506,12 +850,12 @@ bool setChipBiases(ICM20948_BASE &chip);
 	/*
 	* @name:	viewPacket
 	* @brief:	Take a look at the 3-axis quat ouput table
-	* @param:	long * finalBodyArray 			== Public array which holds ouput data
+	* @param:	int32_t * finalBodyArray		== Public array which holds ouput data
 	* @param:	int getChip						== **optional** Get data from a specific sensor. If not set, defaults to show all sensor data
 	* @return:	void
 	* @type		CORE
 	*/
-	void viewPacket(long * finalBodyArray, int getChip = -1);
+	void viewPacket(int32_t * finalBodyArray, int getChip = -1);
 
 	/*
 	* @name:	updateHandPacket
@@ -536,6 +880,8 @@ bool setChipBiases(ICM20948_BASE &chip);
 	* @param:	unsigned char state				== Tells what to do (0 = quat data, 1 = send reset flag, 2 = send rdy flag)
 	* @return:	void
 	* @type		CONTROLLER
+	* @note:	Quat data is followed by the sample's age (16 bit, HAND_AGE_UNIT_US units, clamped to HAND_AGE_MAX) counted back
+	*			from the frame's Build Time, which goes out with it, so the core can place it on its own clock
 	*/
 	void updateSPIChip(ICM20948_BASE &chip, int quePos, unsigned char * HandArray, unsigned char state);
 
@@ -545,46 +891,53 @@ bool setChipBiases(ICM20948_BASE &chip);
 	* @param: 	ICM20948_BASE &chip 			== Core IMU struct
 	* @param: 	unsigned char chipCounter 		== number ID of the chip
 	* @param: 	unsigned short chipsEnabled 	== enabled chip bitmask
+	* @param: 	unsigned short chipsDue 		== Chips due this frame (odrDueMask) - the rest return straight away, no SPI traffic
 	* @return:	bool check						== True if error, false if OK
 	* @type		CONTROLLER
+	* @note:	Blocking path - controllerScheduler uses SPIPipe, which overlaps the next chip's transfer with this chip's decode.
+	*			Hand chips put to sleep by the core (chip_slp_1/2) are checked with chipWomFired and woken on the hand itself.
 	*/
-	bool pollSensor(ICM20948_BASE &chip, unsigned char chipCounter, unsigned short chipsErrored);
+	bool pollSensor(ICM20948_BASE &chip, unsigned char chipCounter, unsigned short chipsErrored, unsigned short chipsDue);
 
 	/*
 	* @name:	getHandPacket
-	* @brief:	Get the Quat9 data from each of the hands
+	* @brief:	Get the Quat9 data from each of the hands (paged HAND_LINK_VERSION 1 protocol - see readHandFrame)
 	* @param:	I2CBank &i2c 					== One of two (L/R) hand structs that provide a buffer for the core
 	* @param:	uint64_t &sensorEnable 			== Bitmap of the chips that are enabled for that hand
 	* @param:	uint64_t &sensorReset 			== Bitmap of the chips that need to be reset
 	* @param:	uint64_t &sensorReady 			== Bitmap of the chips that are now ready to send data
-	* @param:	long * finalBodyArray 			== The return data from the hand (formatted with gaps)
+	* @param:	int32_t * finalBodyArray		== The return data from the hand (formatted with gaps)
+	* @param:	unsigned long * sampleStamp 	== Core-clock sample time of each sensor (hand ages converted with handClockOffset)
 	* @return:	void
 	* @type		CORE
 	*/
-	void getHandPacket(I2CBank &i2c, uint64_t &sensorEnable, uint64_t &sensorReset, uint64_t &sensorReady, uint64_t &sensorErrored, long * finalBodyArray);
+	void getHandPacket(I2CBank &i2c, uint64_t &sensorEnable, uint64_t &sensorReset, uint64_t &sensorReady, uint64_t &sensorErrored, int32_t * finalBodyArray, unsigned long * sampleStamp);
 
 	/*
 	* @name:	getCoreBodyArray
 	* @brief:	Copy data from indevidual sensor array to body array 
 	* @param:	struct ICM20948_BASE chips[16]	== Array of Core IMU structs
-	* @param:	long * finalBodyArray			== Current data packet prototype
+	* @param:	int32_t * finalBodyArray		== Current data packet prototype
 	* @param:	uint64_t EnSensorMask			== Sensor power/data state from host
 	* @return:	void
 	* @type		CORE
 	*/
-	void getCoreBodyArray(struct ICM20948_BASE chips[CORE_CHIPS], long * finalBodyArray, uint64_t EnSensorMask);
+	void getCoreBodyArray(struct ICM20948_BASE chips[CORE_CHIPS], int32_t * finalBodyArray, uint64_t EnSensorMask);
 
 
 	/*
 	* @name:	readCoreIMU
 	* @brief:	Read IMU data from 
 	* @param:	struct ICM20948_BASE chips[16]	== Array of Core IMU structs
-	* @param:	long * finalBodyArray			== Current data packet prototype
-	* @param:	uint64_t EnSensorMask			== Sensor power/data state from host
+	* @param:	int32_t * finalBodyArray		== Current data packet prototype
+	* @param:	uint64_t EnSensorMask			== Sensor power/data state from host, AND'd with odrDueMask for this frame
 	* @return:	void
 	* @type		CORE
+	* @note:	A chip that is not due is skipped before selectMux, so its slot keeps the last sample and its bus time goes
+	*			to the chips that are. A chip that is asleep gets a chipWomFired check instead of a FIFO read;
+	*			if it fired, the chip is woken right there and reported with powerWake.
 	*/
-	bool readCoreIMU(ICM20948_BASE &chip, long * finalBodyArray, uint64_t EnSensorMask, unsigned char sensorNumber);
+	bool readCoreIMU(ICM20948_BASE &chip, int32_t * finalBodyArray, uint64_t EnSensorMask, unsigned char sensorNumber);
 
 	/*
 	* @name:	dmp_get_fifo
@@ -607,6 +960,58 @@ bool setChipBiases(ICM20948_BASE &chip);
 	*/
 	bool dmp_get_fifo(ICM20948_BASE &chip, long * out_data, bool chipWorking);
 
+	/*
+	* @name:	dmp_drain_fifo
+	* @brief:	Burst read the whole FIFO count in one transaction and walk every Ivory Packet in place.
+	*			Packet lengths come from ivoryH1Length/ivoryH2Length instead of branching on each header bit,
+	*			and quaternions are decoded straight out of the burst buffer into out_data (no packet copies).
+	*			A trailing partial packet is left in the FIFO for the next drain.
+	* @param:	ICM20948_BASE &chip 			== Core IMU struct
+	* @param:	unsigned char * buff 			== Burst buffer, at least IVORY_DRAIN_SIZE bytes (one per bus/task)
+	* @param:	long * out_data 				== 3-Axis Quaternion output, 3 longs per packet (oldest first)
+	* @param:	unsigned char maxPackets 		== Room in out_data, in packets (up to IVORY_MAX_PACKETS)
+	* @param:	unsigned char &numPackets 		== Number of quaternions written to out_data
+	* @param:	bool chipWorking 				== if the particular chip is currently enabled
+	* @return:	bool check						== True if error, false if OK
+	* @type		BOTH
+	* @note:	chip.sampleTime is stamped when the burst read completes.
+	*			The newest quaternion is also copied to chip.sensorOutput, and the latest accuracy words to
+	*			chip.CalAccelStat/CalGyroStat/CalMagStat, so existing callers of sensorOutput keep working.
+	*/
+	bool dmp_drain_fifo(ICM20948_BASE &chip, unsigned char * buff, long * out_data, unsigned char maxPackets, unsigned char &numPackets, bool chipWorking);
+
+	/*
+	* @name:	ivoryDecode
+	* @brief:	Walk a buffer of Ivory Packets in place (the decode half of dmp_drain_fifo, with no bus access)
+	* @param:	ICM20948_BASE &chip 			== Core IMU struct (accuracy states and sensorOutput are updated)
+	* @param:	const unsigned char * buff 		== Raw FIFO bytes, starting on a packet boundary
+	* @param:	unsigned short len 				== Number of valid bytes in buff
+	* @param:	long * out_data 				== 3-Axis Quaternion output, 3 longs per packet
+	* @param:	unsigned char maxPackets 		== Room in out_data, in packets
+	* @param:	unsigned char &numPackets 		== Number of quaternions written to out_data
+	* @return:	unsigned short used				== Bytes consumed (anything past this is a partial packet), 0xFFFF on a corrupt header
+	* @type		BOTH
+	*/
+	unsigned short ivoryDecode(ICM20948_BASE &chip, const unsigned char * buff, unsigned short len, long * out_data, unsigned char maxPackets, unsigned char &numPackets);
+
+	/*
+	* @name:	ivoryH1Key
+	* @brief:	Compress Header1 to a 3-bit table key (bit 0 = QUAT6, bit 1 = QUAT9, bit 2 = HEADER2)
+	* @param:	unsigned short header1 			== Big-endian Header1 word from the FIFO
+	* @return:	unsigned char key				== Index into ivoryH1Length
+	* @type		BOTH
+	*/
+	unsigned char ivoryH1Key(unsigned short header1);
+
+	/*
+	* @name:	ivoryH2Key
+	* @brief:	Compress Header2 to a 3-bit table key (bit 0 = accel, bit 1 = gyro, bit 2 = mag accuracy)
+	* @param:	unsigned short header2 			== Big-endian Header2 word from the FIFO
+	* @return:	unsigned char key				== Index into ivoryH2Length
+	* @type		BOTH
+	*/
+	unsigned char ivoryH2Key(unsigned short header2);
+
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 //											  MATH 											   //
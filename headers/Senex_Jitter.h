@@ -0,0 +1,129 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, BOTH, or HOST.  |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+//Adaptive jitter buffer + loss concealment for one suit stream (HOST side)
+
+#ifndef _SENEX_JITTER_H
+#define _SENEX_JITTER_H
+
+#include <stdint.h>
+
+#include "Senex_Receiver.h"
+
+//Frames the buffer can hold (power of 2, indexed by the unwrapped 32-bit packetOrderNumber from the receiver)
+#define JB_SLOTS 32
+
+//Playout depth limits (us). Depth = JB_JITTER_MULT * measured jitter, clamped to these.
+#define JB_MIN_DEPTH_US 2000
+#define JB_MAX_DEPTH_US 120000
+#define JB_JITTER_MULT 3
+
+//Longest run of missing frames that is concealed; past this the last frame is held instead of extrapolated
+#define JB_MAX_CONCEAL 3
+
+//Playout metrics
+struct JitterStats
+{
+	uint64_t framesIn;
+	uint64_t framesOut;
+
+	//Arrived after their slot was played out (concealed or not), or already had
+	uint64_t late;
+	uint64_t duplicates;
+
+	//Frames filled by extrapolation, and late frames that corrected a concealed one
+	uint64_t concealed;
+	uint64_t corrections;
+
+	//Current playout depth, measured inter-arrival jitter, and mean arrival-to-playout latency (us)
+	uint32_t depthUs;
+	uint32_t jitterUs;
+	uint32_t latencyUs;
+};
+
+
+class JitterBuffer
+{
+	public:
+		/*
+		* @name:	JitterBuffer
+		* @brief:	Build a buffer for one suit
+		* @param:	uint32_t framePeriodUs 			== Nominal sender frame period (17857 at 56 fps)
+		* @type		HOST
+		*/
+		JitterBuffer(uint32_t framePeriodUs);
+
+		/*
+		* @name:	push
+		* @brief:	Insert an arrived frame in sequence order and update the jitter estimate (RFC 3550 style smoothing)
+		* @param:	const RxFrame &frame 			== Frame from the receiver
+		* @param:	uint64_t arrivalUs 				== Host arrival time
+		* @return:	void
+		* @type		HOST
+		*/
+		void push(const RxFrame &frame, uint64_t arrivalUs);
+
+		/*
+		* @name:	pull
+		* @brief:	Play out the next frame if its time has come. A missing frame is concealed by extrapolating each quaternion
+		*			with its angular velocity from the last two played frames; output never waits for a late packet.
+		* @param:	uint64_t nowUs 					== Host time
+		* @param:	RxFrame &out 					== Frame out
+		* @param:	bool &concealed 				== True if out was extrapolated
+		* @return:	bool check						== True if nothing is due yet, false if out was filled
+		* @type		HOST
+		* @note:	When the real frame for a concealed slot turns up late, it becomes the base for the next extrapolation
+		*			(counted in corrections) so the error does not accumulate.
+		*/
+		bool pull(uint64_t nowUs, RxFrame &out, bool &concealed);
+
+		void reset();
+
+		JitterStats stats;
+
+	private:
+		RxFrame slot[JB_SLOTS];
+		bool filled[JB_SLOTS];
+		uint64_t arrival[JB_SLOTS];
+
+		uint32_t framePeriodUs;
+
+		//Next sequence number to play, and when it is due
+		int32_t nextSeq;
+		uint64_t nextPlayUs;
+		bool started;
+
+		//Jitter estimate state
+		int64_t lastTransit;
+		uint32_t jitterUs;
+
+		//Last two played frames (for angular velocity) and how many frames in a row were concealed
+		RxFrame prev;
+		RxFrame last;
+		unsigned char concealRun;
+};
+
+
+	/*
+	* @name:	extrapolateFrame
+	* @brief:	out = last advanced by (last * conj(prev)) ^ steps for every present sensor
+	* @param:	const RxFrame &prev 			== Frame before last
+	* @param:	const RxFrame &last 			== Last frame
+	* @param:	float steps 					== Frames to extrapolate forward
+	* @param:	RxFrame &out 					== Extrapolated frame
+	* @return:	void
+	* @type		HOST
+	*/
+	void extrapolateFrame(const RxFrame &prev, const RxFrame &last, float steps, RxFrame &out);
+
+#endif
@@ -0,0 +1,189 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, or BOTH.        |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+#ifndef _SENEX_LOG_H
+#define _SENEX_LOG_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+//Log levels (records above LOG_LEVEL compile to nothing)
+#define LOG_ERROR 0
+#define LOG_INFO 1
+#define LOG_VERBOSE 2
+
+#ifndef LOG_LEVEL
+	#ifdef FULL_DATA
+		#define LOG_LEVEL LOG_VERBOSE
+	#else
+		#define LOG_LEVEL LOG_INFO
+	#endif
+#endif
+
+//Records in the ring (power of 2)
+#define LOG_RING_SIZE 256
+
+//Arguments per record, and inline text bytes for runtime strings (logPushText / String)
+#define LOG_MAX_ARGS 4
+#define LOG_TEXT_SIZE 16
+
+//Formatted text produced per drain (one UDP debug packet)
+#define LOG_DRAIN_SIZE 1024
+
+//What a record's payload holds
+enum LogType
+{
+	LOG_FMT,		//printf-style format + up to LOG_MAX_ARGS 32-bit args
+	LOG_LITERAL,	//text that outlives the drain (fmt points at it)
+	LOG_TEXT,		//short runtime text copied inline
+	LOG_LONG,		//one signed integer
+	LOG_ULONG,		//one unsigned integer
+	LOG_U64,		//one 64-bit unsigned integer (args[0] low, args[1] high)
+	LOG_HEX,		//one unsigned integer printed in hex
+	LOG_HEX64,		//one 64-bit unsigned integer printed in hex
+	LOG_CHAR,		//one character
+	LOG_FLOAT		//one float
+};
+
+//LogRecord::type flag - end the line after this record
+#define LOG_EOL 0x80
+
+//Fixed-size binary log record (no heap, formatted later by the drain)
+struct LogRecord
+{
+	//micros() when the record was pushed
+	uint32_t timestamp;
+
+	//Format string - a literal, so the pointer doubles as the format ID
+	const char * fmt;
+
+	unsigned char type;
+	unsigned char numArgs;
+
+	//Slot sequence: equal to the ring position when the slot is free for that position, position + 1 once the
+	//producer has filled it, and position + LOG_RING_SIZE after the drain has formatted it
+	std::atomic<uint32_t> seq;
+
+	union
+	{
+		uint32_t args[LOG_MAX_ARGS];
+		char text[LOG_TEXT_SIZE];
+		float f;
+	};
+};
+
+//Multi-producer, single-consumer ring of log records. A producer only claims a position (compare-exchange on head)
+//after seeing that slot's seq equal to it, so a claimed slot is always free and always gets filled - nothing is ever
+//claimed and then given up. The drain formats records while their seq says they are filled; a slot still being
+//written ends the drain early and is picked up on the next one.
+struct LogRing
+{
+	LogRecord rec[LOG_RING_SIZE];
+
+	//Next position to claim (producers) and next position to format (drain - written by the drain only, read by the
+	//producers on the other core to see how full the ring is)
+	std::atomic<uint32_t> head;
+	std::atomic<uint32_t> tail;
+
+	//Records thrown away because the ring was full (the sampler never waits on the log)
+	std::atomic<uint32_t> dropped;
+};
+
+
+	/*
+	* @name:	logPush
+	* @brief:	Push a record without allocating or formatting (overloads pick the record type, one per Serial.print
+	*			overload PRINT used to reach, so PRINT(char) still prints a character and PRINT(uint64_t) compiles)
+	* @param:	LogRing &ring 					== Ring to push into
+	* @param:	(value) 						== Text, character, integer or float to log
+	* @param:	bool newline = false 			== Also end the line (PRINTLN)
+	* @return:	bool check						== True if the ring was full and the record was dropped, false if OK
+	* @type		BOTH
+	* @note:	The const char * overload stores the pointer, not the text (LOG_LITERAL) - it is meant for string literals,
+	*			which is what PRINT("...") passes. Text that may change or go out of scope before the drain runs (a
+	*			local char buffer) must go through logPushText, which copies it.
+	*/
+	bool logPush(LogRing &ring, const char * text, bool newline = false);
+	bool logPush(LogRing &ring, char value, bool newline = false);
+	bool logPush(LogRing &ring, long value, bool newline = false);
+	bool logPush(LogRing &ring, unsigned long value, bool newline = false);
+	bool logPush(LogRing &ring, int value, bool newline = false);
+	bool logPush(LogRing &ring, unsigned int value, bool newline = false);
+	bool logPush(LogRing &ring, unsigned long long value, bool newline = false);
+	bool logPush(LogRing &ring, double value, bool newline = false);
+	bool logPushHex(LogRing &ring, int value, bool newline = false);
+	bool logPushHex(LogRing &ring, unsigned int value, bool newline = false);
+	bool logPushHex(LogRing &ring, long value, bool newline = false);
+	bool logPushHex(LogRing &ring, unsigned long value, bool newline = false);
+	bool logPushHex(LogRing &ring, unsigned long long value, bool newline = false);
+	#ifdef ARDUINO
+		//Callers that already built a String (its text is copied inline, truncated to LOG_TEXT_SIZE - 1)
+		bool logPush(LogRing &ring, const String &text, bool newline = false);
+	#endif
+
+	/*
+	* @name:	logPushText
+	* @brief:	Push runtime text by value (copied inline, truncated to LOG_TEXT_SIZE - 1 characters)
+	* @param:	LogRing &ring 					== Ring to push into
+	* @param:	const char * text 				== Text to copy (only read during the call)
+	* @param:	bool newline = false 			== Also end the line
+	* @return:	bool check						== True if the record was dropped, false if OK
+	* @type		BOTH
+	*/
+	bool logPushText(LogRing &ring, const char * text, bool newline = false);
+
+	/*
+	* @name:	logPushFmt
+	* @brief:	Push a format string and its arguments (only %d, %u, %x, %c and %f (as float bits) are supported)
+	* @param:	LogRing &ring 					== Ring to push into
+	* @param:	const char * fmt 				== String literal (its address is the record's format ID)
+	* @param:	unsigned char numArgs 			== Number of arguments used (up to LOG_MAX_ARGS)
+	* @param:	uint32_t a0 - a3 				== Arguments, as raw 32-bit values
+	* @return:	bool check						== True if the record was dropped, false if OK
+	* @type		BOTH
+	*/
+	bool logPushFmt(LogRing &ring, const char * fmt, unsigned char numArgs, uint32_t a0 = 0, uint32_t a1 = 0, uint32_t a2 = 0, uint32_t a3 = 0);
+
+	/*
+	* @name:	logDrain
+	* @brief:	Format queued records into text (run by streamDebugInfo on the other ESP32 core)
+	* @param:	LogRing &ring 					== Ring to drain
+	* @param:	char * out 						== Text output
+	* @param:	unsigned short maxLen 			== Size of out (LOG_DRAIN_SIZE)
+	* @return:	unsigned short len 				== Bytes written to out (0 if nothing was queued)
+	* @type		BOTH
+	*/
+	unsigned short logDrain(LogRing &ring, char * out, unsigned short maxLen);
+
+
+//Leveled format logging. Arguments are cast to 32 bits at the call site; nothing is formatted on the hot path.
+#if LOG_LEVEL >= LOG_ERROR
+	#define LOGE(ring, fmt, n, ...) logPushFmt(ring, fmt, n, ##__VA_ARGS__);
+#else
+	#define LOGE(ring, fmt, n, ...)
+#endif
+
+#if LOG_LEVEL >= LOG_INFO
+	#define LOGI(ring, fmt, n, ...) logPushFmt(ring, fmt, n, ##__VA_ARGS__);
+#else
+	#define LOGI(ring, fmt, n, ...)
+#endif
+
+#if LOG_LEVEL >= LOG_VERBOSE
+	#define LOGV(ring, fmt, n, ...) logPushFmt(ring, fmt, n, ##__VA_ARGS__);
+#else
+	#define LOGV(ring, fmt, n, ...)
+#endif
+
+#endif
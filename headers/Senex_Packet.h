@@ -0,0 +1,143 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, or BOTH.        |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+//Compact body frame wire format (SXF). No Arduino dependencies, so the same encoder/decoder builds on a PC.
+
+#ifndef _SENEX_PACKET_H
+#define _SENEX_PACKET_H
+
+#include <stdint.h>
+
+//SUIT_SLOTS/BODY_ARRAY_SIZE (no Arduino dependencies either)
+#include "Senex_Settings.h"
+
+/* SXF frame layout:
+* -----------------------------------------------------------------------------------------------------------
+* | Size: (B)		In Pkt?		Data 				Description												|
+* -----------------------------------------------------------------------------------------------------------
+* | 1 byte: 		ALWAYS		Magic      			SXF_MAGIC												|
+* | 1 byte: 		ALWAYS		Version/Flags  		High nibble = SXF_VERSION, bit 0 = keyframe				|
+* | 2 bytes: 		ALWAYS		Sequence     		Low 16 bits of packetOrderNumber						|
+* | 2 bytes: 		ALWAYS		Key Sequence  		Sequence of the keyframe this frame is relative to		|
+* | 5 bytes: 		ALWAYS		Presence Mask		Bits 0-35 from imu_rdy (which slots follow)				|
+* | 5 bytes: 		DELTA		Delta Mask			Slot in delta form (1) or full form (0)					|
+* | 5 bytes: 		ASLEEP		Asleep Mask			Bits 0-35 from imu_slp (alive, not in Presence)			|
+* | 6 bytes: 		PER SLOT	Full Sample			Smallest-three: 2b index + 3 * 15b components + 1b pad	|
+* | 3 bytes: 		PER SLOT	Delta Sample		3 * int8 deltas of the quantized components				|
+* -----------------------------------------------------------------------------------------------------------
+* Slots are stored in presence-mask order. A delta is only used when the largest component has the same index
+* as in the keyframe and all three deltas fit in an int8; anything else goes out in full form.
+*/
+
+#define SXF_MAGIC 0x5A
+#define SXF_VERSION 2
+#define SXF_FLAG_KEYFRAME 0x01
+#define SXF_FLAG_ASLEEP 0x02
+
+//Sensor slots carried - presence bit n is body slot n, so a full mask fits the BODY_ARRAY_SIZE array exactly
+#define SXF_MAX_SLOTS SUIT_SLOTS
+
+//Send a keyframe at least this often (in frames) so a late joiner or a lost keyframe recovers quickly
+#define SXF_KEYFRAME_INTERVAL 28
+
+#define SXF_HEADER_SIZE 11
+#define SXF_FULL_SAMPLE 6
+#define SXF_DELTA_SAMPLE 3
+
+//Worst case frame (keyframe with every slot present)
+#define SXF_MAX_FRAME (SXF_HEADER_SIZE + 5 + 5 + SXF_MAX_SLOTS * SXF_FULL_SAMPLE)
+
+//Quantized sample (smallest-three)
+struct SXFSample
+{
+	//Index (0-3 = x, y, z, w) of the dropped largest component
+	unsigned char largest;
+
+	//The other three components, scaled from [-1/sqrt(2), 1/sqrt(2)] to [-16383, 16383]
+	short q[3];
+};
+
+//Encoder state (one per stream)
+struct SXFEncoder
+{
+	SXFSample key[SXF_MAX_SLOTS];
+	uint64_t keyMask;
+	unsigned short keySeq;
+	unsigned char framesSinceKey;
+
+	//Set to force the next frame to be a keyframe (e.g. when a client connects)
+	bool forceKey;
+};
+
+//Decoder state (one per suit)
+struct SXFDecoder
+{
+	SXFSample key[SXF_MAX_SLOTS];
+	uint64_t keyMask;
+	unsigned short keySeq;
+
+	//False until the first keyframe arrives; delta frames before that are dropped
+	bool haveKey;
+};
+
+
+	/*
+	* @name:	sxfQuantize
+	* @brief:	Q30 3-axis DMP quaternion -> smallest-three sample (w is rebuilt from x, y, z and taken as positive)
+	* @param:	const int32_t * q30				== 3 Q30 components, as in finalBodyArray
+	* @param:	SXFSample &out 					== Quantized sample
+	* @return:	void
+	* @type		BOTH
+	*/
+	void sxfQuantize(const int32_t * q30, SXFSample &out);
+
+	/*
+	* @name:	sxfDequantize
+	* @brief:	Smallest-three sample -> Q30 3-axis quaternion (sign flipped so w >= 0, to match the DMP output)
+	* @param:	const SXFSample &in 			== Quantized sample
+	* @param:	int32_t * q30					== 3 Q30 components out
+	* @return:	void
+	* @type		BOTH
+	*/
+	void sxfDequantize(const SXFSample &in, int32_t * q30);
+
+	/*
+	* @name:	sxfEncodeFrame
+	* @brief:	Encode one body frame
+	* @param:	SXFEncoder &enc 				== Encoder state
+	* @param:	const int32_t * finalBodyArray	== Body frame (3 Q30 int32s per slot)
+	* @param:	uint64_t presence 				== Slots to send (imu_rdy & ~imu_slp)
+	* @param:	uint64_t asleep 				== Sleeping slots (imu_slp) - sent as the Asleep Mask when non-zero
+	* @param:	long packetOrderNumber 			== Frame sequence number
+	* @param:	unsigned char * out 			== Output buffer, at least SXF_MAX_FRAME bytes
+	* @return:	unsigned short len 				== Encoded length in bytes
+	* @type		BOTH
+	*/
+	unsigned short sxfEncodeFrame(SXFEncoder &enc, const int32_t * finalBodyArray, uint64_t presence, uint64_t asleep, long packetOrderNumber, unsigned char * out);
+
+	/*
+	* @name:	sxfDecodeFrame
+	* @brief:	Decode one frame into a BODY_ARRAY_SIZE body array (slots not present are left untouched)
+	* @param:	SXFDecoder &dec 				== Decoder state
+	* @param:	const unsigned char * in 		== Received bytes
+	* @param:	unsigned short len 				== Number of received bytes
+	* @param:	int32_t * finalBodyArray		== Body frame out (BODY_ARRAY_SIZE int32s)
+	* @param:	uint64_t &presence 				== Slots that were filled
+	* @param:	uint64_t &asleep 				== Slots asleep on the suit (alive - not dead - but not in presence)
+	* @param:	unsigned short &seq 			== Frame sequence number
+	* @return:	bool check						== True if error (bad magic/version/length, or delta against a keyframe we do not have), false if OK
+	* @type		BOTH
+	*/
+	bool sxfDecodeFrame(SXFDecoder &dec, const unsigned char * in, unsigned short len, int32_t * finalBodyArray, uint64_t &presence, uint64_t &asleep, unsigned short &seq);
+
+#endif
@@ -0,0 +1,175 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, or BOTH.        |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+//Motion-gated IMU power governor. Runs on the core, where every sensor's quaternion stream ends up.
+
+#ifndef _SENEX_POWER_H
+#define _SENEX_POWER_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "Senex_Settings.h"
+
+struct ICM20948_BASE;
+
+//A sensor is "still" while its angular rate (from consecutive quaternions) stays under this (millidegrees/s)
+#define POWER_STILL_MDPS 3000
+
+//Stillness before a chip drops to low power, and before it is put to sleep (ms, changeable at runtime)
+#define POWER_LOW_MS 5000
+#define POWER_SLEEP_MS 30000
+
+//Wake-on-motion threshold (mg, 4mg steps in ACCEL_WOM_THR)
+#define POWER_WOM_MG 40
+
+//Frames between INT_STATUS checks of a sleeping chip (one byte read in place of its FIFO read)
+#define POWER_WOM_POLL 2
+
+//Wake-to-first-sample limit (ms). The wake itself never waits on a deferrable stage: the bus reader that sees the WOM
+//event restarts the chip on the spot, so a wake takes at most POWER_WOM_POLL frames plus the gyro/DMP start-up. Slower
+//wakes are counted in slowWakes and the chip is not put back to sleep until it has stayed still for POWER_SLEEP_MS again.
+#define POWER_WAKE_LIMIT_MS 40
+
+/* Power states (ChipPower::state):
+* -----------------------------------------------------------------------------------------------------------
+* |  State			Chip setup								Stream								|
+* -----------------------------------------------------------------------------------------------------------
+* |  PWR_ACTIVE		Normal DMP operation at its own odrDiv		imu_rdy								|
+* |  PWR_LOW		fullPower(false), read at ODR_MAX_DIV		imu_rdy (fewer samples)				|
+* |  PWR_SLEEP		Gyro, mag and DMP off, accel duty-cycled	imu_rdy + imu_slp, slot holds the	|
+* |					with wake-on-motion armed					last sample							|
+* |  PWR_WAKING		Gyro/DMP restarted by the reader on WOM		imu_rdy + imu_slp until the first	|
+* |																new sample arrives					|
+* -----------------------------------------------------------------------------------------------------------
+* The governor never touches odrDiv. Entering or leaving PWR_LOW marks the chip in imu_odr_dirty, and
+* doSuitSettingsUpdate (the only code that picks an odrDiv - resets just re-apply the current one) applies ODR_MAX_DIV
+* while the chip is in lowMask and the host's imu_odr otherwise, so a host rate change made while a chip is in PWR_LOW
+* is the one it comes back to.
+*/
+enum PowerState
+{
+	PWR_ACTIVE,
+	PWR_LOW,
+	PWR_SLEEP,
+	PWR_WAKING
+};
+
+//Governor state for one sensor
+struct ChipPower
+{
+	unsigned char state;
+
+	//Last quaternion seen and when the sensor last moved (ms)
+	long lastQ[3];
+	unsigned long stillSince;
+
+	//When the current wake started (us), the last and worst wake-to-first-sample times (us) and number of wakes
+	unsigned long wakeStart;
+	unsigned long lastWakeUs;
+	unsigned long worstWakeUs;
+	unsigned short wakeups;
+	unsigned short slowWakes;
+};
+
+struct PowerGovernor
+{
+	ChipPower chip[36];
+
+	//Limits in use (start at the POWER_* defaults)
+	unsigned short stillMdps;
+	unsigned long lowMs;
+	unsigned long sleepMs;
+
+	//Which states the governor may use: ctrl_1 bit 0 allows PWR_LOW, ctrl_2 bit 7 allows PWR_SLEEP
+	bool allowLow;
+	bool allowSleep;
+
+	//Chips in PWR_LOW, and chips in PWR_SLEEP or PWR_WAKING (copied into imu_slp every frame)
+	uint64_t lowMask;
+	uint64_t sleepMask;
+
+	//Chips whose state changed and still need their chip commands sent (core chips directly, hand chips through
+	//chip_slp_1/2 on the next LINK_CTRL_CHIPS request)
+	uint64_t pending;
+
+	//Wake handoff from the read path: the reader (or readHandFrame) writes wokenAt[chip], then sets the chip's bit in
+	//woken; powerUpdate takes the whole mask with one exchange. Nothing else in the governor is touched off the
+	//scheduler task.
+	unsigned long wokenAt[36];
+	std::atomic<uint64_t> woken;
+};
+
+
+	/*
+	* @name:	powerInit
+	* @brief:	Start every chip in PWR_ACTIVE with the default limits
+	* @param:	PowerGovernor &gov 				== Governor state
+	* @return:	void
+	* @type		CORE
+	*/
+	void powerInit(PowerGovernor &gov);
+
+	/*
+	* @name:	powerUpdate
+	* @brief:	Once per frame (STAGE_SETTINGS): take gov.woken and move those chips to PWR_WAKING, estimate each ready
+	*			sensor's angular rate from its last two quaternions, move chips that have been still for lowMs/sleepMs down a
+	*			state, and finish wakes whose first new sample has arrived (recording the wake time).
+	* @param:	PowerGovernor &gov 				== Governor state
+	* @param:	const int32_t * finalBodyArray	== Frame just published
+	* @param:	uint64_t imu_rdy 				== Sensors with live data
+	* @param:	unsigned long nowUs 			== Core micros()
+	* @return:	uint64_t changed 				== Chips that changed state this call (also OR'd into gov.pending). The caller ORs
+	*											   the ones entering or leaving PWR_LOW into imu_odr_dirty.
+	* @type		CORE
+	*/
+	uint64_t powerUpdate(PowerGovernor &gov, const int32_t * finalBodyArray, uint64_t imu_rdy, unsigned long nowUs);
+
+	/*
+	* @name:	powerApply
+	* @brief:	Send the pending sleep/low-power changes of core chips (chipSleepWOM(true) / chipLowPower), at most maxChips
+	*			per call. Wakes are not sent here - the reader already did them.
+	* @param:	PowerGovernor &gov 				== Governor state
+	* @param:	struct ICM20948_BASE chips[]	== Core chip array
+	* @param:	unsigned char numChips 			== Chips in the array
+	* @param:	unsigned char maxChips 			== Chips allowed this call
+	* @return:	bool check						== True if error, false if OK
+	* @type		CORE
+	*/
+	bool powerApply(PowerGovernor &gov, struct ICM20948_BASE chips[], unsigned char numChips, unsigned char maxChips);
+
+	/*
+	* @name:	powerWake
+	* @brief:	Report a wake from the read path: readCoreIMU calls it after chipWomFired fired and it has already restarted
+	*			the chip (chipSleepWOM(chip, false)), readHandFrame when the hand's asleep mask drops a bit (the hand wakes
+	*			its own chips). Writes wokenAt and sets the bit in gov.woken; the rest happens in powerUpdate.
+	* @param:	PowerGovernor &gov 				== Governor state
+	* @param:	unsigned char chipNum 			== Sensor that woke
+	* @param:	unsigned long nowUs 			== Core micros() when the event was seen
+	* @return:	void
+	* @type		CORE
+	* @note:	Safe from either bus reader task - it only touches wokenAt[chipNum] and the atomic mask
+	*/
+	void powerWake(PowerGovernor &gov, unsigned char chipNum, unsigned long nowUs);
+
+	/*
+	* @name:	printPowerStats
+	* @brief:	Print each chip's state, wakes and wake times
+	* @param:	PowerGovernor &gov 				== Governor state
+	* @return:	void
+	* @type		CORE
+	*/
+	void printPowerStats(PowerGovernor &gov);
+
+#endif
@@ -0,0 +1,151 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, or BOTH.        |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+//Batched quaternion postprocessing (S_IO::ctrl_2 bit 4). Builds on the ESP32 and on a PC with the same API.
+
+#ifndef _SENEX_QUAT_H
+#define _SENEX_QUAT_H
+
+#include <stdint.h>
+
+//SUIT_SLOTS/BODY_ARRAY_SIZE
+#include "Senex_Settings.h"
+
+//Sensors per frame (one lane per body slot, so a full batch packs into exactly BODY_ARRAY_SIZE values), and the batch
+//width rounded up to a whole number of 8-float AVX2 vectors
+#define QUAT_BATCH_SIZE SUIT_SLOTS
+#define QUAT_BATCH_PAD ((QUAT_BATCH_SIZE + 7) & ~7)
+
+static_assert(QUAT_BATCH_SIZE * 3 == BODY_ARRAY_SIZE, "quatBatchToQ30 writes 3 values for every batch lane");
+
+//Parent index for a sensor at the root of the skeleton
+#define QUAT_ROOT 0xFF
+
+//Backend picked at compile time
+#if defined(__AVX2__)
+	#define QUAT_BACKEND_AVX2
+#elif defined(ESP32)
+	#define QUAT_BACKEND_ESP32
+#else
+	#define QUAT_BACKEND_SCALAR
+#endif
+
+//One frame of quaternions in structure-of-arrays form (each component contiguous, 32-byte aligned)
+struct QuatBatch
+{
+	alignas(32) float w[QUAT_BATCH_PAD];
+	alignas(32) float x[QUAT_BATCH_PAD];
+	alignas(32) float y[QUAT_BATCH_PAD];
+	alignas(32) float z[QUAT_BATCH_PAD];
+};
+
+//Per-suit skeleton + sensor mounting
+struct QuatSkeleton
+{
+	//Parent sensor of each sensor (QUAT_ROOT for the pelvis/torso root)
+	unsigned char parent[QUAT_BATCH_SIZE];
+
+	//Rotation from each sensor's frame to its bone's frame, applied before the relative rotations
+	QuatBatch mount;
+};
+
+
+	/*
+	* @name:	quatBatchFromQ30
+	* @brief:	Unpack a body frame: Q30 -> float, rebuild w = sqrt(1 - x^2 - y^2 - z^2), normalize
+	* @param:	const int32_t * finalBodyArray	== Body frame (3 Q30 int32s per sensor)
+	* @param:	QuatBatch &out 					== World rotations (identity for sensors not in presence)
+	* @param:	uint64_t presence 				== Sensors with live data (imu_rdy)
+	* @return:	void
+	* @type		BOTH
+	*/
+	void quatBatchFromQ30(const int32_t * finalBodyArray, QuatBatch &out, uint64_t presence);
+
+	/*
+	* @name:	quatBatchMount
+	* @brief:	q[i] = q[i] * mount[i] for every sensor
+	* @param:	QuatBatch &q 					== Rotations, updated in place
+	* @param:	const QuatBatch &mount 			== Per-sensor mounting offsets
+	* @return:	void
+	* @type		BOTH
+	*/
+	void quatBatchMount(QuatBatch &q, const QuatBatch &mount);
+
+	/*
+	* @name:	quatBatchRelative
+	* @brief:	Joint rotations along the skeleton: rel[i] = conj(world[parent[i]]) * world[i] (root sensors are copied)
+	* @param:	const QuatBatch &world 			== World rotations
+	* @param:	const unsigned char * parent 	== Parent table (QuatSkeleton::parent)
+	* @param:	QuatBatch &rel 					== Parent-relative rotations
+	* @return:	void
+	* @type		BOTH
+	* @note:	Parents are gathered into a temporary batch first so the multiply runs over contiguous lanes
+	*/
+	void quatBatchRelative(const QuatBatch &world, const unsigned char * parent, QuatBatch &rel);
+
+	/*
+	* @name:	quatBatchToQ30
+	* @brief:	Pack a batch back into a body frame (x, y, z in Q30, sign flipped so w >= 0 like the DMP output)
+	* @param:	const QuatBatch &in 			== Rotations
+	* @param:	int32_t * finalBodyArray		== Body frame out (BODY_ARRAY_SIZE int32s - all QUAT_BATCH_SIZE lanes are written)
+	* @return:	void
+	* @type		BOTH
+	*/
+	void quatBatchToQ30(const QuatBatch &in, int32_t * finalBodyArray);
+
+	/*
+	* @name:	quatPostProcess
+	* @brief:	Full pass: unpack, mount, relative rotations, repack into a separate joint array
+	* @param:	const int32_t * finalBodyArray	== Raw sensor samples (left untouched, so slots carried forward by publishFrame
+	*											   are never processed twice)
+	* @param:	int32_t * jointArray			== Joint rotations out (BODY_ARRAY_SIZE int32s)
+	* @param:	const QuatSkeleton &skel 		== Skeleton and mounting offsets
+	* @param:	uint64_t presence 				== Sensors with live data (imu_rdy)
+	* @return:	void
+	* @type		CORE
+	*/
+	void quatPostProcess(const int32_t * finalBodyArray, int32_t * jointArray, const QuatSkeleton &skel, uint64_t presence);
+
+	/*
+	* @name:	alignBodyFrame
+	* @brief:	Resample every sensor to frameInstant by slerping (or extrapolating up to one frame) between its last two samples
+	* @param:	int32_t * finalBodyArray		== Newest samples, rewritten in place at frameInstant
+	* @param:	const int32_t * prevBodyArray	== Previous samples
+	* @param:	const unsigned long * stamp 	== Sample time of each newest sample (core micros)
+	* @param:	const unsigned long * prevStamp == Sample time of each previous sample
+	* @param:	unsigned long frameInstant 		== Time the frame should represent
+	* @param:	uint64_t presence 				== Sensors with live data (imu_rdy)
+	* @return:	void
+	* @type		CORE
+	*/
+	void alignBodyFrame(int32_t * finalBodyArray, const int32_t * prevBodyArray, const unsigned long * stamp, const unsigned long * prevStamp, unsigned long frameInstant, uint64_t presence);
+
+	/*
+	* @name:	frameSkewUs
+	* @brief:	Spread between the oldest and newest sample in a frame (measured on the raw stamps, before alignBodyFrame)
+	* @param:	const unsigned long * stamp 	== Sample time of each sensor
+	* @param:	uint64_t presence 				== Sensors to include
+	* @return:	unsigned long skew 				== us
+	* @type		BOTH
+	*/
+	unsigned long frameSkewUs(const unsigned long * stamp, uint64_t presence);
+
+	/*
+	* @name:	quatBackendName
+	* @brief:	Name of the compiled backend ("avx2", "esp32" or "scalar"), for benchmark output
+	* @return:	const char * name
+	* @type		BOTH
+	*/
+	const char * quatBackendName();
+
+#endif
@@ -0,0 +1,188 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, BOTH, or HOST.  |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+//Multi-suit UDP receiver (HOST side - Linux, uses recvmmsg)
+
+#ifndef _SENEX_RECEIVER_H
+#define _SENEX_RECEIVER_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include <sys/socket.h>
+
+#include "Senex_Packet.h"
+
+/* Stream packet (as sent by streamPacket, all fields big-endian via int32_to_big8):
+* -----------------------------------------------------------------------------------------------------------
+* | Size: (B)		Data 				Description															|
+* -----------------------------------------------------------------------------------------------------------
+* |   4 bytes:		UID 				Suit UID (e.g. 0x53583031 = "SX01")									|
+* |   4 bytes:		packetOrderNumber	Frame sequence number												|
+* | 420 bytes:		finalBodyArray		Slots 0-34: LEGACY_BODY_VALUES * int32, 3 Q30 components per slot		|
+* -----------------------------------------------------------------------------------------------------------
+* Compact frames (first byte SXF_MAGIC) are prefixed with the same 4 byte UID and decoded with sxfDecodeFrame.
+*/
+
+#define RX_LEGACY_SIZE (8 + LEGACY_BODY_VALUES * 4)
+
+//Datagrams pulled per recvmmsg call, and the preallocated receive ring behind them
+#define RX_BATCH 64
+#define RX_MAX_DATAGRAM 512
+
+//Suits one receiver can demultiplex, and frames each suit's queue holds
+#define RX_MAX_SUITS 128
+#define RX_QUEUE_FRAMES 256
+
+//A decoded frame, ready for a consumer
+struct RxFrame
+{
+	uint32_t uid;
+
+	//Frame sequence, always 32-bit and monotonic (SXF carries only the low 16 bits - see rxUnwrapSeq)
+	int32_t packetOrderNumber;
+
+	//Slots that carry data (bits 0-34 for legacy packets, the presence mask for SXF)
+	uint64_t presence;
+
+	//Slots asleep on the suit (SXF only) - alive and holding their last sample, unlike a slot that is simply absent
+	uint64_t asleep;
+
+	//Host receive time (CLOCK_MONOTONIC, ns) taken once per recvmmsg batch
+	uint64_t rxTimeNs;
+
+	//Same layout as BodyFrame on the core (slot n = mask bit n), so sxfDecodeFrame writes straight into it
+	int32_t finalBodyArray[BODY_ARRAY_SIZE];
+};
+
+//Single-producer (receiver thread), single-consumer (one per suit) frame queue
+struct SuitQueue
+{
+	RxFrame frames[RX_QUEUE_FRAMES];
+	std::atomic<uint32_t> head;
+	std::atomic<uint32_t> tail;
+
+	uint32_t uid;
+
+	//SXF decoder state for this suit
+	SXFDecoder sxf;
+
+	//Last unwrapped sequence, and whether one has been seen yet
+	int32_t lastSeq;
+	bool seqValid;
+
+	//Frames lost because the consumer fell behind
+	std::atomic<uint64_t> dropped;
+};
+
+//Receiver counters
+struct RxStats
+{
+	uint64_t syscalls;
+	uint64_t datagrams;
+	uint64_t frames;
+	uint64_t badPackets;
+	uint64_t unknownSuits;
+	uint64_t queueDrops;
+};
+
+
+class SuitReceiver
+{
+	public:
+		SuitReceiver(void);
+		~SuitReceiver();
+
+		/*
+		* @name:	open
+		* @brief:	Bind the UDP port and preallocate the recvmmsg ring and suit queues (nothing is allocated after this)
+		* @param:	unsigned short port 			== UDP port the suits stream to
+		* @param:	int rcvBuf 						== SO_RCVBUF size in bytes (0 = leave the default)
+		* @return:	bool check						== True if error, false if OK
+		* @type		HOST
+		*/
+		bool open(unsigned short port, int rcvBuf = 0);
+
+		/*
+		* @name:	addSuit
+		* @brief:	Register a suit UID and get its queue (unregistered UIDs are counted in unknownSuits and dropped)
+		* @param:	uint32_t uid 					== Suit UID
+		* @return:	SuitQueue * queue 				== Queue for that suit, NULL if RX_MAX_SUITS are already registered
+		* @type		HOST
+		*/
+		SuitQueue * addSuit(uint32_t uid);
+
+		/*
+		* @name:	poll
+		* @brief:	One recvmmsg of up to RX_BATCH datagrams; each is decoded straight out of the receive ring into its suit's queue
+		* @param:	int timeoutMs 					== How long to wait for the first datagram (-1 = forever)
+		* @return:	int count 						== Frames delivered, -1 on socket error
+		* @type		HOST
+		*/
+		int poll(int timeoutMs);
+
+		/*
+		* @name:	pop
+		* @brief:	Consumer side - take the oldest frame from a suit's queue
+		* @param:	SuitQueue &queue 				== Queue from addSuit
+		* @param:	RxFrame &frame 					== Frame out
+		* @return:	bool check						== True if the queue was empty, false if OK
+		* @type		HOST
+		*/
+		static bool pop(SuitQueue &queue, RxFrame &frame);
+
+		RxStats stats;
+
+	private:
+		int fd;
+
+		//recvmmsg ring: RX_BATCH headers/iovecs pointing into one contiguous buffer
+		struct mmsghdr msgs[RX_BATCH];
+		struct iovec iov[RX_BATCH];
+		unsigned char * buffers;
+
+		//Registered suits, with a small open-addressed UID -> queue table for the hot lookup
+		SuitQueue * queues;
+		unsigned short numSuits;
+		unsigned short lookup[RX_MAX_SUITS * 2];
+
+		SuitQueue * findSuit(uint32_t uid);
+};
+
+
+	/*
+	* @name:	rxUnwrapSeq
+	* @brief:	Extend a 16-bit SXF sequence to 32 bits: lastSeq + (int16_t)(seq16 - (uint16_t)lastSeq). Frames up to 32767
+	*			behind or ahead land on the right side of the wrap, so the 65536-frame rollover (about 19.5 minutes at
+	*			56 fps) is invisible to the jitter buffer.
+	* @param:	int32_t lastSeq 				== Last unwrapped sequence for this suit
+	* @param:	uint16_t seq16 					== Sequence from the SXF header
+	* @return:	int32_t seq 					== Unwrapped sequence
+	* @type		HOST
+	*/
+	int32_t rxUnwrapSeq(int32_t lastSeq, uint16_t seq16);
+
+	/*
+	* @name:	rxDecodeLegacy
+	* @brief:	Decode a big-endian stream packet into a frame (no intermediate copy of the payload). Fills slots 0-34;
+	*			slot 35 is zeroed and left out of presence.
+	* @param:	const unsigned char * data 		== Datagram
+	* @param:	int len 						== Datagram length (must be RX_LEGACY_SIZE)
+	* @param:	RxFrame &frame 					== Frame out
+	* @return:	bool check						== True if error, false if OK
+	* @type		HOST
+	*/
+	bool rxDecodeLegacy(const unsigned char * data, int len, RxFrame &frame);
+
+#endif
@@ -0,0 +1,256 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, BOTH, or HOST.  |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+//Suit capture recordings (HOST side - Linux/macOS, uses mmap and a writer thread)
+
+#ifndef _SENEX_RECORD_H
+#define _SENEX_RECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <thread>
+
+/* Recording layout (all fields little-endian):
+* -----------------------------------------------------------------------------------------------------------
+* | Block			Count		Data 																		|
+* -----------------------------------------------------------------------------------------------------------
+* | RecFileHeader	1			Magic, version, suit UID, start time										|
+* | RecChunkHeader	per chunk	Frame count, byte length, first/last suitTimer of the chunk				|
+* | RecFrameHeader	per frame	suitTimer, packetOrderNumber, 36-bit sensor mask							|
+* | Samples			per frame	3 * int32 (Q30) for each bit set in the mask, in bit order					|
+* | Padding			per frame	4 zero bytes when the sample count is odd, so every frame is 8-byte aligned	|
+* | RecIndexEntry	per chunk	First suitTimer of the chunk + file offset of its RecChunkHeader			|
+* | RecFooter		1			Index offset/count, total frames, magic (always the last 32 bytes)			|
+* -----------------------------------------------------------------------------------------------------------
+* Frames mirror the body frame: one header + only the sensors that were in imu_rdy. Chunks are capped at
+* REC_CHUNK_FRAMES, so a seek is a binary search of the footer index plus a scan of at most one chunk.
+* A file without a valid footer (crash mid-capture) is still readable by walking the chunks; recoverRecording
+* rebuilds the footer.
+* suitTimer in the file is always non-decreasing, so the index binary search in seek is valid for every file it writes:
+* a backwards step larger than REC_REBOOT_STEP_MS is a suit reboot and is folded into a running offset; a smaller one
+* (frames reordered across the queue) is clamped to the last time written and leaves the offset alone.
+*/
+
+#define REC_MAGIC 0x43455258		//"XREC"
+#define REC_FOOTER_MAGIC 0x444E4558	//"XEND"
+#define REC_CHUNK_MAGIC 0x4B4E4843	//"CHNK"
+#define REC_VERSION 2
+
+//Frames per chunk (about 4.5s at 56 fps)
+#define REC_CHUNK_FRAMES 256
+
+//Sensor slots per frame (matches imu_rdy)
+#define REC_MAX_SLOTS 36
+
+//Frames the writer queue can hold before push() starts dropping (about 18s at 56 fps)
+#define REC_QUEUE_FRAMES 1024
+
+//Backwards suitTimer step (ms) above which the writer treats it as a suit reboot rather than reordering
+#define REC_REBOOT_STEP_MS 1000
+
+struct RecFileHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t slots;
+	uint32_t uid;
+	uint32_t reserved;
+	uint64_t startTime;		//Host wall clock (us since epoch) when recording started
+};
+
+struct RecChunkHeader
+{
+	uint32_t magic;
+	uint32_t frames;
+	uint32_t bytes;			//Bytes of frame data after this header
+	uint32_t firstTime;
+	uint32_t lastTime;
+	uint32_t reserved;
+};
+
+//Frames start on 8-byte boundaries (see Padding), so the mask can be read in place from the mapping
+struct RecFrameHeader
+{
+	//Suit timer, made monotonic by the writer
+	uint32_t suitTimer;
+	int32_t packetOrderNumber;
+	uint64_t mask;
+};
+
+struct RecIndexEntry
+{
+	uint32_t firstTime;
+	uint32_t reserved;
+	uint64_t offset;
+};
+
+struct RecFooter
+{
+	uint64_t indexOffset;
+	uint64_t indexCount;
+	uint64_t frames;
+	uint32_t reserved;
+	uint32_t magic;
+};
+
+//One frame as handed to the writer
+struct RecFrame
+{
+	uint32_t suitTimer;
+	int32_t packetOrderNumber;
+	uint64_t mask;
+	int32_t sample[REC_MAX_SLOTS * 3];
+};
+
+//Zero-copy view of a frame inside the mapping
+struct RecFrameView
+{
+	const RecFrameHeader * header;
+
+	//3 int32 per bit set in header->mask
+	const int32_t * samples;
+};
+
+
+//Append-only writer. push() only copies into a ring; a background thread builds chunks and writes them.
+class RecordWriter
+{
+	public:
+		RecordWriter(void);
+		~RecordWriter();
+
+		/*
+		* @name:	open
+		* @brief:	Create the file, write the header and start the writer thread
+		* @param:	const char * path 				== Output file
+		* @param:	uint32_t uid 					== Suit UID
+		* @return:	bool check						== True if error, false if OK
+		* @type		HOST
+		*/
+		bool open(const char * path, uint32_t uid);
+
+		/*
+		* @name:	push
+		* @brief:	Queue a frame. Never blocks the receive path - if the ring is full the frame is counted in dropped.
+		* @param:	const RecFrame &frame 			== Frame to record
+		* @return:	bool check						== True if the frame was dropped, false if OK
+		* @type		HOST
+		*/
+		bool push(const RecFrame &frame);
+
+		/*
+		* @name:	close
+		* @brief:	Drain the queue, write the last chunk, the index and the footer
+		* @return:	bool check						== True if error, false if OK
+		* @type		HOST
+		*/
+		bool close();
+
+		std::atomic<uint64_t> written;
+		std::atomic<uint64_t> dropped;
+
+		//Times the suit timer stepped back by more than REC_REBOOT_STEP_MS and was folded into timeOffset
+		std::atomic<uint64_t> timeSteps;
+
+		//Times the suit timer stepped back by less than that and was clamped to lastTime
+		std::atomic<uint64_t> clampedSteps;
+
+	private:
+		int fd;
+
+		//SPSC ring between push() and the writer thread
+		RecFrame * queue;
+		std::atomic<uint32_t> head;
+		std::atomic<uint32_t> tail;
+
+		//Index built up as chunks are written
+		RecIndexEntry * index;
+		uint64_t indexCount;
+		uint64_t indexCap;
+
+		//Last suitTimer written and the offset added across reboots to keep it monotonic (writer thread only)
+		uint32_t lastTime;
+		uint32_t timeOffset;
+
+		std::atomic<bool> running;
+		std::thread thread;
+
+		void writerLoop();
+};
+
+
+//Read-only mapped recording
+class RecordReader
+{
+	public:
+		RecordReader(void);
+		~RecordReader();
+
+		/*
+		* @name:	open
+		* @brief:	mmap a recording and locate its footer index
+		* @param:	const char * path 				== Recording file
+		* @return:	bool check						== True if error (or no valid footer - see recoverRecording), false if OK
+		* @type		HOST
+		*/
+		bool open(const char * path);
+
+		/*
+		* @name:	seek
+		* @brief:	Position at the first frame with suitTimer >= time (binary search of the index, then one chunk)
+		* @param:	uint32_t time 					== suitTimer to seek to
+		* @return:	bool check						== True if time is past the end, false if OK
+		* @type		HOST
+		*/
+		bool seek(uint32_t time);
+
+		/*
+		* @name:	next
+		* @brief:	Read the frame at the current position and step past it
+		* @param:	RecFrameView &view 				== Pointers into the mapping (valid until close)
+		* @return:	bool check						== True at end of file, false if OK
+		* @type		HOST
+		*/
+		bool next(RecFrameView &view);
+
+		void close();
+
+		const RecFileHeader * header;
+		uint64_t frames;
+
+	private:
+		const unsigned char * map;
+		size_t mapSize;
+
+		const RecIndexEntry * index;
+		uint64_t indexCount;
+
+		//Current chunk, and byte position inside the mapping
+		uint64_t chunk;
+		uint32_t chunkFramesLeft;
+		size_t pos;
+};
+
+
+	/*
+	* @name:	recoverRecording
+	* @brief:	Walk the chunks of a recording with no footer (crashed writer), truncate a partial last chunk, and append the index + footer
+	* @param:	const char * path 				== Recording file
+	* @return:	bool check						== True if error, false if OK
+	* @type		HOST
+	*/
+	bool recoverRecording(const char * path);
+
+#endif
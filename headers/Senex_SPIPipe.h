@@ -0,0 +1,160 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, or BOTH.        |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+#ifndef _SENEX_SPIPIPE_H
+#define _SENEX_SPIPIPE_H
+
+#include <stdint.h>
+
+#include "Senex_Settings.h"
+
+//ATOMIC_BLOCK for the 16-bit fields shared with the SPI interrupt
+#ifdef __AVR__
+	#include <util/atomic.h>
+#endif
+
+struct ICM20948_BASE;
+
+//Number of chips in flight at once (one being transferred while the other is decoded)
+#define SPI_PIPE_DEPTH 2
+
+//FIFO bytes fetched per chip per frame (4 QUAT9 packets with Header2 + accuracy words)
+#define SPI_PIPE_BUFF 96
+
+//Bytes in a hand packet slot for one chip (3 big-endian quaternion components)
+#define SPI_PIPE_SLOT 12
+
+//Where each chip is in the pipeline
+enum SPIPipeStage
+{
+	PIPE_IDLE,
+	PIPE_COUNT,		//FIFO_COUNTH/L transfer in flight
+	PIPE_DATA,		//FIFO_R_W burst in flight
+	PIPE_DECODE,	//Bytes landed, waiting for the main loop to decode them
+	PIPE_DONE
+};
+
+//One chip's place in the pipeline
+struct SPIPipeSlot
+{
+	ICM20948_BASE *chip;
+
+	//SPIPipeStage - written by onTransferDone (ISR) and polled by service()
+	volatile unsigned char stage;
+
+	//Byte offset of this chip's quaternion in HandArray
+	int quePos;
+
+	//Written by onTransferDone when the count transfer lands. 16 bits are two loads on AVR, so service() reads it
+	//inside ATOMIC_BLOCK(ATOMIC_RESTORESTATE).
+	volatile unsigned short fifoCount;
+	unsigned char buff[SPI_PIPE_BUFF];
+};
+
+//Frame timing, to compare per-hand ODR and jitter against the polled path
+struct SPIPipeStats
+{
+	unsigned long frames;
+	unsigned long lastFrameUs;
+	unsigned long minFrameUs;
+	unsigned long maxFrameUs;
+
+	//Running mean and mean absolute deviation of the frame period (us)
+	unsigned long meanPeriodUs;
+	unsigned long jitterUs;
+
+	//Time the CPU spent waiting on SPI (0 when the pipeline is full)
+	unsigned long stallUs;
+};
+
+
+//Non-blocking SPI read engine for the hand controllers. While chip N's FIFO bytes are decoded in the main loop,
+//the transfer queue is already clocking chip N+1's FIFO count and FIFO data. Transfers are driven by the SPI
+//transfer-complete interrupt (or DMA where the controller has it, with SPI_PIPE_DMA defined).
+class SPIPipe
+{
+	public:
+		SPIPipe(void);
+
+		/*
+		* @name:	begin
+		* @brief:	Attach the pipeline to the hand's chip array and hook the SPI interrupt
+		* @param:	struct ICM20948_BASE chips[10]	== Array of Controller IMU structs
+		* @return:	void
+		* @type		CONTROLLER
+		*/
+		void begin(struct ICM20948_BASE chips[CONTROLLER_CHIPS]);
+
+		/*
+		* @name:	startFrame
+		* @brief:	Queue one FIFO read for every enabled, non-errored chip that is due (odrDueMask) and start the first transfer
+		* @param:	unsigned char * HandArray		== Outgoing hand packet - quaternions are decoded straight into their slots
+		* @param:	unsigned short chipsEnabled		== Which chips are currently enebled by the master and due this frame
+		* @param:	unsigned short chipsErrored		== Chips that have reported and error condition (skipped)
+		* @return:	bool check						== True if a frame is already running, false if OK
+		* @type		CONTROLLER
+		*/
+		bool startFrame(unsigned char * HandArray, unsigned short chipsEnabled, unsigned short chipsErrored);
+
+		/*
+		* @name:	service
+		* @brief:	Decode any slot whose bytes have landed and recycle it for the next chip. Call from controllerScheduler.
+		* @return:	bool done						== True once every chip in the frame is decoded
+		* @type		CONTROLLER
+		*/
+		bool service();
+
+		/*
+		* @name:	onTransferDone
+		* @brief:	SPI/DMA completion handler - advances the in-flight slot and starts the next queued transfer
+		* @return:	void
+		* @type		CONTROLLER
+		*/
+		void onTransferDone();
+
+		//Chips that returned new data / failed in the last frame (same bit layout as chipsEnabled)
+		unsigned short chipsUpdated;
+		unsigned short chipsFailed;
+
+		SPIPipeStats stats;
+
+	private:
+		ICM20948_BASE *chips;
+		unsigned char * HandArray;
+
+		SPIPipeSlot slot[SPI_PIPE_DEPTH];
+
+		//Chips left to start this frame (cleared bit by bit by onTransferDone, so startFrame/service touch it only inside
+		//ATOMIC_BLOCK(ATOMIC_RESTORESTATE)), and which one is on the wire
+		volatile unsigned short chipsQueued;
+		volatile unsigned char activeSlot;
+
+		unsigned long frameStart;
+};
+
+
+	/*
+	* @name:	spiPipeModelFrameUs
+	* @brief:	Host-side timing model of one hand frame, for comparing the polled and pipelined read paths
+	* @param:	unsigned char numChips 			== Chips read per frame
+	* @param:	unsigned short bytesPerChip 	== FIFO bytes fetched per chip (count read included)
+	* @param:	unsigned long spiClock 			== SPI clock (Hz)
+	* @param:	unsigned long decodeUs 			== CPU time to decode one chip
+	* @param:	unsigned long setupUs 			== Per-transfer CS/setup overhead
+	* @param:	bool pipelined 					== false = transfer and decode back to back (pollSensor), true = overlapped
+	* @return:	unsigned long frameUs 			== Modelled frame time
+	* @type		BOTH
+	*/
+	unsigned long spiPipeModelFrameUs(unsigned char numChips, unsigned short bytesPerChip, unsigned long spiClock, unsigned long decodeUs, unsigned long setupUs, bool pipelined);
+
+#endif
@@ -0,0 +1,289 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, or BOTH.        |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+#ifndef _SENEX_SCHEDULER_H
+#define _SENEX_SCHEDULER_H
+
+#include <stdint.h>
+
+#include "Senex_Settings.h"
+
+#include "Senex_Telemetry.h"
+
+#if defined CORE && defined ARDUINO
+	#include "freertos/FreeRTOS.h"
+	#include "freertos/event_groups.h"
+	#include "freertos/semphr.h"
+#endif
+
+struct ICM20948_BASE;
+
+//Frame period that follows ODR_TICK_HZ (35714us at 28 fps, 17857us at 56 fps)
+#define FRAME_PERIOD_US (1000000UL / ODR_TICK_HZ)
+
+//Frame stages, in the order they run. Stages from STAGE_FIRST_DEFERRABLE on are skipped when the frame is late.
+enum FrameStage
+{
+	STAGE_CORE_READ,		//I2C chips (core) / SPI chips (controller)
+	STAGE_HAND_READ,		//getHandPacket for both hands (core only, primary bus lock)
+	STAGE_PUBLISH,			//Frame handed to the stream task / hand packet updated
+	STAGE_RESET,			//updateCoreChipReset / updateControllerChipReset (core: lock of the bus being reset)
+	STAGE_SETTINGS,			//doSuitSettingsUpdate / doControlUpdate / powerUpdate (core: powerApply takes the bus locks)
+	STAGE_ACTUATORS,		//LED/haptic writes from the ActuatorQueue, only what fits the slack (core: secondary bus lock)
+	STAGE_EEPROM,			//Bias writes
+	STAGE_COUNT
+};
+
+#define STAGE_FIRST_DEFERRABLE STAGE_RESET
+
+static_assert(STAGE_COUNT == TELEMETRY_STAGES, "TELEMETRY_STAGES must match STAGE_COUNT (and bump TELEMETRY_VERSION)");
+
+//Default per-stage budgets (us). The fixed stages add up to well under FRAME_PERIOD_US at 56 fps.
+#define BUDGET_CORE_READ 7000
+#define BUDGET_HAND_READ 4000
+#define BUDGET_PUBLISH 500
+#define BUDGET_RESET 3000
+#define BUDGET_SETTINGS 1000
+#define BUDGET_ACTUATORS 1500
+#define BUDGET_EEPROM 2000
+
+//Frames in a row a deferrable stage may be pushed back before it runs regardless of slack (that frame runs late
+//instead of the stage starving under sustained load)
+#define SCHED_MAX_DEFER 8
+
+//Per-frame state and overrun records
+struct FrameScheduler
+{
+	//Start of the current frame and of the next one (advanced by FRAME_PERIOD_US, so there is no drift)
+	unsigned long frameStart;
+	unsigned long nextFrame;
+
+	//Stage currently running and when it started
+	unsigned char stage;
+	unsigned long stageStart;
+
+	//Budget, last run time and worst run time for each stage (us)
+	unsigned long budgetUs[STAGE_COUNT];
+	unsigned long lastUs[STAGE_COUNT];
+	unsigned long worstUs[STAGE_COUNT];
+
+	//Times each stage ran past its budget, and times a deferrable stage was pushed to a later frame
+	unsigned long overruns[STAGE_COUNT];
+	unsigned long deferrals[STAGE_COUNT];
+
+	//Deferrable stages waiting for a frame with enough slack (bit = FrameStage), how many frames in a row each has
+	//waited, and the runs forced by SCHED_MAX_DEFER
+	unsigned char deferred;
+	unsigned char deferStreak[STAGE_COUNT];
+	unsigned long forcedRuns[STAGE_COUNT];
+
+	//Frames that ended after nextFrame, and frames dropped outright to get back on the grid
+	unsigned long lateFrames;
+	unsigned long skippedFrames;
+	unsigned long frames;
+};
+
+
+	/*
+	* @name:	schedInit
+	* @brief:	Load the default budgets and start the frame grid at the current time
+	* @param:	FrameScheduler &sched 			== Scheduler state
+	* @return:	void
+	* @type		BOTH
+	*/
+	void schedInit(FrameScheduler &sched);
+
+	/*
+	* @name:	schedBeginFrame
+	* @brief:	Wait for the next frame boundary (replaces MAINLOOP_DEBUG_DELAY). If more than one period was missed,
+	*			the grid is moved forward and the missed frames are counted in skippedFrames.
+	* @param:	FrameScheduler &sched 			== Scheduler state
+	* @return:	void
+	* @type		BOTH
+	*/
+	void schedBeginFrame(FrameScheduler &sched);
+
+	/*
+	* @name:	schedRunStage
+	* @brief:	Decide whether a stage may run now and start its timer. Fixed stages always run; deferrable stages only
+	*			run if the time left in the frame covers their budget, otherwise they are marked in sched.deferred. A stage
+	*			already deferred SCHED_MAX_DEFER frames in a row runs anyway (forcedRuns), and running clears its streak.
+	* @param:	FrameScheduler &sched 			== Scheduler state
+	* @param:	unsigned char stage 			== FrameStage about to run
+	* @return:	bool run						== True if the stage should run this frame
+	* @type		BOTH
+	*/
+	bool schedRunStage(FrameScheduler &sched, unsigned char stage);
+
+	/*
+	* @name:	schedEndStage
+	* @brief:	Stop the stage timer and record an overrun if it went past budget
+	* @param:	FrameScheduler &sched 			== Scheduler state
+	* @return:	void
+	* @type		BOTH
+	*/
+	void schedEndStage(FrameScheduler &sched);
+
+	/*
+	* @name:	schedSlackUs
+	* @brief:	Time left before the next frame boundary
+	* @param:	FrameScheduler &sched 			== Scheduler state
+	* @return:	long slack 						== us left (negative if the frame is already late)
+	* @type		BOTH
+	*/
+	long schedSlackUs(FrameScheduler &sched);
+
+	/*
+	* @name:	printSchedStats
+	* @brief:	Debug printout of stage times, overruns and deferrals
+	* @param:	FrameScheduler &sched 			== Scheduler state
+	* @return:	void
+	* @type		BOTH
+	*/
+	void printSchedStats(FrameScheduler &sched);
+
+
+#if defined CORE && defined ARDUINO
+
+//ESP32 core each bus reader is pinned to (the WiFi/UDP tasks share core 0 with the secondary reader)
+#define PRIMARY_READER_CORE 1
+#define SECONDARY_READER_CORE 0
+
+//FrameBarrier event bits
+#define BARRIER_PRIMARY_START 0x01
+#define BARRIER_PRIMARY_DONE 0x02
+#define BARRIER_SECONDARY_DONE 0x04
+#define BARRIER_SECONDARY_START 0x08
+
+//Per-bus reader task state. A reader holds its bus's lock (FrameBarrier::busLock) from startBit until doneBit, and
+//with it the bus's mux state and stats (lastMux/stats[isSecondaryI2C]). Its drain buffer and staging slots are its own.
+struct BusReader
+{
+	//All core chips; the reader only touches those whose isSecondaryI2C matches its own
+	ICM20948_BASE * chips;
+	bool isSecondaryI2C;
+
+	//Core the task is pinned to, the barrier bit that releases it, and the bit it sets when its half of the frame is in
+	unsigned char cpuCore;
+	unsigned char startBit;
+	unsigned char doneBit;
+
+	//Where this reader decodes its chips (BODY_ARRAY_SIZE int32s and SUIT_SLOTS stamps, allocated by startBusReaders). Only
+	//readCoreFrame copies them into the body frame, after doneBit, so a late reader never writes into a published frame.
+	int32_t * staging;
+	unsigned long * stagingStamp;
+
+	//Released but not done yet. A busy reader is not released again; its slots keep their last value until it finishes,
+	//and it still holds its bus lock, so coreScheduler stages on that bus are deferred rather than run alongside it.
+	bool busy;
+
+	//Burst buffer for dmp_drain_fifo (IVORY_DRAIN_SIZE bytes, allocated by startBusReaders)
+	unsigned char * drainBuff;
+
+	//Enabled chips that are due this frame (imu_en & odrDueMask, bit = chipNum), set by the scheduler before startBit
+	uint64_t EnSensorMask;
+
+	//Read time for the last frame and the worst so far (us)
+	unsigned long readUs;
+	unsigned long worstReadUs;
+	unsigned long frames;
+
+	//Frames this reader missed the readCoreFrame timeout
+	unsigned long lateFrames;
+
+	TaskHandle_t task;
+};
+
+//Start/finish handshake between coreScheduler and the two readers
+struct FrameBarrier
+{
+	EventGroupHandle_t group;
+
+	//One mutex per physical I2C bus (index = isSecondaryI2C). Whoever drives a bus holds its lock: the reader task for
+	//its read, coreScheduler for hand reads, resets, powerApply and the secondary bus DRV2605 writes.
+	SemaphoreHandle_t busLock[2];
+};
+
+
+	/*
+	* @name:	coreBusReaderTask
+	* @brief:	FreeRTOS task body: wait for startBit, read every enabled chip on this bus into staging, set doneBit
+	* @param:	void * pvParameters 			== BusReader *
+	* @return:	void
+	* @type		CORE
+	*/
+	void coreBusReaderTask(void * pvParameters);
+
+	/*
+	* @name:	startBusReaders
+	* @brief:	Create the barrier and bus locks, and pin one reader task per I2C bus to its core
+	* @param:	BusReader &primary 				== Reader for the main bus
+	* @param:	BusReader &secondary 			== Reader for the SDA_2/SCL_2 bus
+	* @param:	FrameBarrier &barrier 			== Barrier shared with coreScheduler
+	* @return:	bool check						== True if error, false if OK
+	* @type		CORE
+	*/
+	bool startBusReaders(BusReader &primary, BusReader &secondary, FrameBarrier &barrier);
+
+	/*
+	* @name:	readCoreFrame
+	* @brief:	Release every reader that is not busy and block until both have finished (or timeoutUs passes), then copy
+	*			the staging slots of each finished reader into the body frame. Acquisition time is the slower of the two
+	*			buses instead of their sum. A reader that times out stays busy (keeping its bus lock) and its slots are
+	*			merged in the frame where it finishes.
+	* @param:	FrameBarrier &barrier 			== Barrier shared with the readers
+	* @param:	BusReader &primary 				== Reader for the main bus
+	* @param:	BusReader &secondary 			== Reader for the SDA_2/SCL_2 bus
+	* @param:	int32_t * finalBodyArray		== Body frame to fill
+	* @param:	unsigned long * sampleStamp 	== Sample stamps of that frame
+	* @param:	unsigned long timeoutUs 		== Give up after this long (BUDGET_CORE_READ)
+	* @return:	bool check						== True if a reader missed the barrier, false if OK
+	* @type		CORE
+	*/
+	bool readCoreFrame(FrameBarrier &barrier, BusReader &primary, BusReader &secondary, int32_t * finalBodyArray, unsigned long * sampleStamp, unsigned long timeoutUs);
+
+	/*
+	* @name:	busTryLock
+	* @brief:	Take a bus for a coreScheduler stage without waiting. Fails while the bus's reader still holds it (a reader
+	*			that missed the readCoreFrame timeout keeps its bus until it finishes); the stage then leaves its work
+	*			in sched.deferred for a later frame instead of sharing the bus with the reader.
+	* @param:	FrameBarrier &barrier 			== Barrier shared with the readers
+	* @param:	bool isSecondaryI2C 			== Which physical bus
+	* @return:	bool check						== True if the bus is busy (do not touch it), false if it is now held
+	* @type		CORE
+	*/
+	bool busTryLock(FrameBarrier &barrier, bool isSecondaryI2C);
+
+	/*
+	* @name:	busUnlock
+	* @brief:	Give back a bus taken with busTryLock
+	* @param:	FrameBarrier &barrier 			== Barrier shared with the readers
+	* @param:	bool isSecondaryI2C 			== Which physical bus
+	* @return:	void
+	* @type		CORE
+	*/
+	void busUnlock(FrameBarrier &barrier, bool isSecondaryI2C);
+
+	/*
+	* @name:	printBusReaderStats
+	* @brief:	Debug printout of the per-bus read time
+	* @param:	BusReader &primary 				== Reader for the main bus
+	* @param:	BusReader &secondary 			== Reader for the SDA_2/SCL_2 bus
+	* @return:	void
+	* @type		CORE
+	*/
+	void printBusReaderStats(BusReader &primary, BusReader &secondary);
+
+#endif
+
+#endif
@@ -4,21 +4,71 @@
 	#define CONTROLLER_CHIPS 10
 	#define CORE_CHIPS 15
 
-	//Enable for CORE Program
-	// #define CORE 
+	//Sensor slots in a body frame - one per bit of the 36-bit imu_en/imu_rdy masks, so mask bit n is always slot n
+	//(finalBodyArray[3n] to [3n + 2]). Core chips use bits 0-15 (bit 15 is spare), the right hand 16-25 and the left hand 26-35.
+	#define SUIT_SLOTS 36
+	#define BODY_ARRAY_SIZE (SUIT_SLOTS * 3)
 
-	//Enable for CONTROLLER program
-	#define LEFT_HAND
-	#define L_CTRL_ADDR 5
+	//The uncompressed stream packet predates slot 35 and keeps its original layout (slots 0-34 only); slot 35 is
+	//carried by SXF frames
+	#define LEGACY_BODY_VALUES 105
+
+	//Device roles (SENEX_ROLE)
+	#define ROLE_CORE 0
+	#define ROLE_LEFT_HAND 1
+	#define ROLE_RIGHT_HAND 2
 
-	// #define RIGHT_HAND
+	#define L_CTRL_ADDR 5
 	#define R_CTRL_ADDR 4
 
+	//Building with -DSENEX_ROLE=ROLE_x picks the role without editing this file (one build per image, same tree).
+	//Without it, the hand-edited lines below decide as before.
+	#ifdef SENEX_ROLE
+		#if SENEX_ROLE == ROLE_CORE
+			#define CORE
+		#elif SENEX_ROLE == ROLE_LEFT_HAND
+			#define LEFT_HAND
+		#elif SENEX_ROLE == ROLE_RIGHT_HAND
+			#define RIGHT_HAND
+		#else
+			#error "SENEX_ROLE must be ROLE_CORE, ROLE_LEFT_HAND or ROLE_RIGHT_HAND"
+		#endif
+	#else
+		//Enable for CORE Program
+		// #define CORE 
+
+		//Enable for CONTROLLER program (LEFT_HAND is the default when no role is picked at all)
+		// #define LEFT_HAND
+
+		// #define RIGHT_HAND
+
+		#if !defined CORE && !defined LEFT_HAND && !defined RIGHT_HAND
+			#define LEFT_HAND
+		#endif
+
+		#if defined CORE
+			#define SENEX_ROLE ROLE_CORE
+		#elif defined RIGHT_HAND
+			#define SENEX_ROLE ROLE_RIGHT_HAND
+		#else
+			#define SENEX_ROLE ROLE_LEFT_HAND
+		#endif
+	#endif
+
+	#if defined LEFT_HAND && defined RIGHT_HAND
+		#error "Both LEFT_HAND and RIGHT_HAND are defined - this image would answer on the wrong CTRL_ADDR"
+	#endif
+
+	#if defined CORE && (defined LEFT_HAND || defined RIGHT_HAND)
+		#error "CORE and a hand role are both defined - pick one (or build with -DSENEX_ROLE)"
+	#endif
+
 	#ifdef CORE
-		#define PRINT(text) logPrint(wirelessIO, String(text));
-		#define PRINTHEX(text) logPrint(wirelessIO, String(text, HEX));
-		#define PRINTLN(text) logPrintln(wirelessIO, String(text));
-		#define PRINTLNHEX(text) logPrintln(wirelessIO, String(text, HEX));
+		//Records go into wirelessIO.log and are formatted by streamDebugInfo (no String allocation on the caller's core)
+		#define PRINT(text) logPush(wirelessIO.log, text);
+		#define PRINTHEX(text) logPushHex(wirelessIO.log, text);
+		#define PRINTLN(text) logPush(wirelessIO.log, text, true);
+		#define PRINTLNHEX(text) logPushHex(wirelessIO.log, text, true);
 		#define SEPARATORLINE() printSeparatorLine(wirelessIO);
 	#else
 		#define PRINT(text) Serial.print(text);
@@ -34,12 +84,35 @@
 	//1 for 28fps, 0 for 56 fps
 	#define ODR_LIMITER 0
 
+	//Frame tick (fps). Each chip runs at this rate or an integer fraction of it (setChipODR), so raising the tick while
+	//slowing the torso chips moves bus time to the fingers and wrists. Defaults to the ODR_LIMITER rate.
+	#if ODR_LIMITER
+		#define ODR_TICK_HZ 28
+	#else
+		#define ODR_TICK_HZ 56
+	#endif
+
+	//Largest per-chip frame divider (a chip with divider N is read on every Nth frame)
+	#define ODR_MAX_DIV 8
+
 	//Adds User-readable statuses to UART output
 	#define USE_TEXT
 
 	//Comment in for ICM20948 Calibration Sequence
 	#define ICM20948_CALIBRATION
 
+	//Resample every sensor to one frame instant (slerp between its last two samples) before publishing
+	// #define ALIGN_FRAMES
+
+	//How often the core re-syncs each hand's clock over I2C (ms)
+	#define CLOCK_SYNC_PERIOD 1000
+
+	//Clock syncs kept per hand, used to fit the hand's offset and drift rate (see syncHandClock)
+	#define CLOCK_SYNC_WINDOW 8
+
+	//Syncs whose round trip is within this of the shortest one in the window count as good (us)
+	#define CLOCK_SYNC_RTT_SLACK_US 40
+
 	//Output Calibration data over debug
 	#define DO_CALIBRATION_TEXT
 
@@ -50,14 +123,22 @@
 	// #define PACKET_SHORT_LENGTH
 
 	//Enables more verbatim status reports (often these make raw data hard to read, or are part of functions that are called often) [SPAMMMMMY]
-	//THIS WILL SLOW DOWN THE ODR OF THE SUIT BY A LOT!! (BE WARNED)
+	//On the CORE this only sets LOG_LEVEL to LOG_VERBOSE - the records are cheap, but the UDP debug stream gets busy
+	//On the controllers it still goes straight to Serial and WILL SLOW DOWN THE ODR BY A LOT!! (BE WARNED)
 	// #define FULL_DATA
 
+	//After a CPU-only reset, resume IMUs that still hold a valid DMP image instead of reflashing them
+	#define WARM_START
+
+	//Bus transactions a chip reset may use per frame, and testFifo retries before a chip is marked errored
+	#define RESET_TXN_BUDGET 8
+	#define RESET_MAX_RETRIES 5
+
 	//When Enabled, it will reset the EEPROM used and any sensor biases written will be cleared
 	// #define RESET_EEPROM
 
 	#ifdef CORE
-		//Whether to add a delay in the main loop
+		//Whether to add a delay in the main loop (on top of the FRAME_PERIOD_US frame grid)
 		// #define MAINLOOP_DEBUG_DELAY
 		#define MAINLOOP_DEBUG_DELAY_TIME 8
 		//Enables OTA communication
@@ -75,6 +156,7 @@
 		#define TEXT_UID "SX01"
 
 		//The amount of EEPROM storage allocated to IMU bias storage ([36 * 15]B for actual data, 2B for IMU bitmask)
+		//Old flat layout - only read once to migrate into the bias partition (PartitionMedium)
 		#define IMU_EEPROM_SIZE 36 * 15 + 2
 
 		//Secondary I2C Pins for Lower body + h***** motors
@@ -88,7 +170,7 @@
 		//Enables/disables SPI type sensors for this microcontroller
 		#define IS_SPI
 
-		//The amount of EEPROM storage allocated to IMU bias storage
+		//The amount of EEPROM storage allocated to IMU bias storage (old flat layout, migrated into the bias store)
 		#define IMU_EEPROM_SIZE 36 * 10 + 2
 
 		//#define USE_LRA
@@ -121,10 +203,17 @@
 		unsigned char muxAddr;
 		unsigned char isSecondaryI2C;
 
-		//Two variables used for read packet/length control
+		//Two variables used for read packet/length control (HAND_LINK_VERSION 1 paging only)
 		unsigned char readCounter;
 		unsigned char TotalReadCounter;
 
+		//Last request sequence sent, and last hand sequence received (a repeat means no new data)
+		unsigned char txSeq;
+		unsigned char rxSeq;
+
+		//Control fields changed by doSuitSettingsUpdate and not yet sent (LINK_CTRL_* bits)
+		unsigned char pendingCtrl;
+
 		//A combined tally of every chip that is active, whether it be sending data, ready to send, or resetting
 		unsigned short chipsAlive;
 
@@ -148,6 +237,13 @@
 		unsigned char chip_cal_1;
 		unsigned char chip_cal_2;
 
+		//Hand sensor frame dividers, one nibble per chip (sent with LINK_CTRL_CHIPS)
+		unsigned char chip_odr[5];
+
+		//Hand sensor sleep bytes (PowerGovernor)
+		unsigned char chip_slp_1;
+		unsigned char chip_slp_2;
+
 		//Buffer register for the DRV2605 sequencer
 		unsigned char wave[8];
 
@@ -156,6 +252,20 @@
 
 		//set to fire the DRV2605 sequencer
 		bool goVibe;
+
+		//Hand clock minus core clock (us) at core time clockOffsetAt, how fast it moves (us per core us - the resonator
+		//drift, a few hundred ppm), and the round trip of the exchange it came from. Read it with handClockOffset.
+		long clockOffset;
+		unsigned long clockOffsetAt;
+		float clockDrift;
+		unsigned long syncRtt;
+		unsigned long lastSync;
+
+		//Last CLOCK_SYNC_WINDOW sync results (offset, round trip, core time t3) and the next entry to overwrite
+		long syncOffsets[CLOCK_SYNC_WINDOW];
+		unsigned long syncRtts[CLOCK_SYNC_WINDOW];
+		unsigned long syncTimes[CLOCK_SYNC_WINDOW];
+		unsigned char syncIndex;
 	};
 
 #endif 
@@ -0,0 +1,192 @@
+/* Comment Syntax:
+* -------------------------------------------------------------------------------------------
+* |   Title   |   Meaning                                                                   |
+* -------------------------------------------------------------------------------------------
+* |   @name   |   The name of the function being defined.                                   |
+* |   @brief  |   A quick definition of what the function does                              |
+* |   @param  |   A parameter in the function, and a simple description of what it is.      |
+* |   @type   |   Whether the function is used in the CONTROLLER, the CORE, BOTH, or HOST.  |
+* |   @note   |   An additional piece of information, usually when the function was tested. |
+* |   @return |   Possible values the function returns, if any.	                            |
+* -------------------------------------------------------------------------------------------
+*/
+
+//Per-sensor latency and bus-health counters, exported on their own UDP port. The packet code has no Arduino
+//dependencies so the host decoder builds from the same header.
+
+#ifndef _SENEX_TELEMETRY_H
+#define _SENEX_TELEMETRY_H
+
+#include <stdint.h>
+
+#include "Senex_Settings.h"
+
+//UDP port and send period (ms) for telemetry packets
+#define TELEMETRY_PORT 4211
+#define TELEMETRY_DELAY 1000
+
+#define TELEMETRY_MAGIC 0x54
+#define TELEMETRY_VERSION 4
+
+//Chips tracked (indexed by ICM20948_BASE::chipNum) and scheduler stages carried (must equal STAGE_COUNT - checked by a
+//static_assert in Senex_Scheduler.h, kept as a number here so host decoders build without the scheduler)
+#define TELEMETRY_CHIPS 36
+#define TELEMETRY_STAGES 7
+
+//FIFO read latency histogram: bucket n counts reads under (64us << n), the last bucket is everything slower
+#define TELEMETRY_BUCKETS 8
+
+//Tasks that write counters on the core. Each writes only its own SuitTelemetry copy, so there is no locking on the hot
+//path. The hands keep no counters (see telemetryRead).
+#define TELEMETRY_WRITERS 3
+#define TELEM_MAIN 0			//coreScheduler / controllerScheduler and everything else
+#define TELEM_PRIMARY 1			//Primary bus reader task
+#define TELEM_SECONDARY 2		//Secondary bus reader task
+
+//Counters for one chip. Live counts only ever go up (wrapping mod 2^16); telemetryBuildPacket sends the difference from its
+//last snapshot, so every packet covers one TELEMETRY_DELAY window without the builder ever writing a live counter.
+//maxReadUs, maxWakeUs and stageWorstUs are per window: the owning writer zeroes them on its first write after
+//telemetryWindow changes.
+struct ChipTelemetry
+{
+	uint16_t readHist[TELEMETRY_BUCKETS];
+	uint16_t reads;
+	uint16_t maxReadUs;
+	uint32_t bytesRead;
+
+	uint16_t fifoOverflows;
+
+	//write_reg/read_reg NACKs, and retries that then succeeded
+	uint16_t nacks;
+	uint16_t retries;
+
+	//selectMux failures seen while reaching this chip
+	uint16_t muxFailures;
+
+	uint16_t resets;
+
+	//Wake-on-motion wakes, and the slowest wake-to-first-sample time (us, saturates at 65535)
+	uint16_t wakeups;
+	uint16_t maxWakeUs;
+};
+
+//Everything one telemetry window holds
+struct SuitTelemetry
+{
+	ChipTelemetry chip[TELEMETRY_CHIPS];
+
+	//Worst stage time per scheduler stage in the window, and the running total time and run count (us). The packet
+	//carries the window's difference of both, so the decoder's mean is stageSumUs / stageRuns.
+	uint16_t stageWorstUs[TELEMETRY_STAGES];
+	uint32_t stageSumUs[TELEMETRY_STAGES];
+	uint16_t stageRuns[TELEMETRY_STAGES];
+
+	//Frames, late frames and skipped frames in the window
+	uint16_t frames;
+	uint16_t lateFrames;
+	uint16_t skippedFrames;
+
+	//Stream packets dropped by the frame exchange (published but never picked up)
+	uint16_t streamSkips;
+};
+
+/* Telemetry packet (little-endian):
+* -----------------------------------------------------------------------------------------------------------
+* | Size: (B)		Data 				Description															|
+* -----------------------------------------------------------------------------------------------------------
+* |  1 byte:		Magic 				TELEMETRY_MAGIC														|
+* |  1 byte:		Version				TELEMETRY_VERSION													|
+* |  2 bytes:		Sequence			Packet counter														|
+* |  4 bytes:		UID 				Suit UID															|
+* |  4 bytes:		suitTimer			End of the window													|
+* |  8 bytes:		Chip Mask			Chips with a record below (any non-zero counter)					|
+* | 38 bytes:		PER CHIP			ChipTelemetry, packed												|
+* | 64 bytes:		ALWAYS				Stage worst, time sum and run count + frame counters				|
+* -----------------------------------------------------------------------------------------------------------
+*/
+
+#define TELEMETRY_HEADER 20
+#define TELEMETRY_CHIP_RECORD 38
+#define TELEMETRY_TRAILER 64
+#define TELEMETRY_MAX_PACKET (TELEMETRY_HEADER + TELEMETRY_CHIPS * TELEMETRY_CHIP_RECORD + TELEMETRY_TRAILER)
+
+#ifdef CORE
+	//The live counters, one copy per writer (written by the sampling paths, only read by the telemetry task)
+	extern SuitTelemetry telemetry[TELEMETRY_WRITERS];
+
+	//Window number, advanced only by telemetryBuildPacket
+	extern volatile uint32_t telemetryWindow;
+#endif
+
+
+#ifdef CORE
+	/*
+	* @name:	telemetryWriter
+	* @brief:	Which telemetry copy the calling task owns (the bus reader tasks by handle, everything else TELEM_MAIN)
+	* @return:	unsigned char writer 			== TELEM_*
+	* @type		CORE
+	*/
+	unsigned char telemetryWriter();
+
+	/*
+	* @name:	telemetryRead
+	* @brief:	Record one FIFO read (called from dmp_drain_fifo/dmp_get_fifo)
+	* @param:	unsigned char chipNum 			== ICM20948_BASE::chipNum
+	* @param:	unsigned long us 				== Time the read took
+	* @param:	unsigned short bytes 			== Bytes read
+	* @param:	unsigned char writer 			== telemetryWriter() of the caller
+	* @return:	void
+	* @type		CORE
+	*/
+	void telemetryRead(unsigned char chipNum, unsigned long us, unsigned short bytes, unsigned char writer);
+#else
+	//The hands never send telemetry, so they keep no counters (3 copies would be over 4KB of AVR RAM). The shared read
+	//and write paths still call these, and they compile away.
+	inline unsigned char telemetryWriter() { return TELEM_MAIN; }
+	inline void telemetryRead(unsigned char, unsigned long, unsigned short, unsigned char) {}
+#endif
+
+	/*
+	* @name:	telemetryBuildPacket
+	* @brief:	Sum the writers' copies, pack the difference from the last snapshot, then advance telemetryWindow
+	* @param:	unsigned char * out 			== TELEMETRY_MAX_PACKET byte buffer
+	* @param:	uint32_t uid 					== Suit UID
+	* @param:	uint32_t suitTimer 				== Window end
+	* @return:	unsigned short len 				== Packet length
+	* @type		CORE
+	*/
+	unsigned short telemetryBuildPacket(unsigned char * out, uint32_t uid, uint32_t suitTimer);
+
+	/*
+	* @name:	telemetryTask
+	* @brief:	FreeRTOS task: pull the scheduler stage times, build a packet every TELEMETRY_DELAY ms, send it on TELEMETRY_PORT
+	* @param:	void * pvParameters 			== S_IO *
+	* @return:	void
+	* @type		CORE
+	*/
+	void telemetryTask(void * pvParameters);
+
+	/*
+	* @name:	telemetryDecode
+	* @brief:	Unpack a telemetry packet (host tool side)
+	* @param:	const unsigned char * in 		== Packet
+	* @param:	unsigned short len 				== Packet length
+	* @param:	SuitTelemetry &out 				== Window counters
+	* @param:	uint32_t &uid 					== Suit UID
+	* @param:	uint16_t &seq 					== Packet sequence (gaps = lost telemetry)
+	* @return:	bool check						== True if error, false if OK
+	* @type		HOST
+	*/
+	bool telemetryDecode(const unsigned char * in, unsigned short len, SuitTelemetry &out, uint32_t &uid, uint16_t &seq);
+
+	/*
+	* @name:	telemetryMerge
+	* @brief:	Add a decoded window into a running total (histograms and counters summed, maxima kept) for live aggregation
+	* @param:	SuitTelemetry &total 			== Running total
+	* @param:	const SuitTelemetry &window 	== Decoded window
+	* @return:	void
+	* @type		HOST
+	*/
+	void telemetryMerge(SuitTelemetry &total, const SuitTelemetry &window);
+
+#endif